@@ -39,6 +39,12 @@ aes128_cbc_encrypt(aes128_ctx* c, void* data,  uint32_t len);
 int 
 aes128_cbc_decrypt(aes128_ctx* c, void* data,  uint32_t len);
 
+int
+aes128_cbc_encrypt_stream(aes128_stream* s, void* data, uint32_t len);
+
+int
+aes128_cbc_decrypt_stream(aes128_stream* s, void* data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,6 +33,44 @@
 extern "C" {
 #endif
 
+/**
+ * CCM key context: the expanded key.
+ */
+typedef struct _aes128_ccm_ctx {
+    aes128_key key;
+} aes128_ccm_ctx;
+
+/**
+ * One message of a batch for aes128_ccm_encrypt_batch() and
+ * aes128_ccm_decrypt_batch(). in and out may be the same buffer.
+ */
+typedef struct _aes128_ccm_msg {
+    const uint8_t *nonce;       /* Nonce, 7 to 13 bytes. */
+    uint32_t nonce_len;
+    const uint8_t *aad;         /* Additional authenticated data. */
+    uint32_t aad_len;
+    const uint8_t *in;          /* Plaintext (encrypt) or ciphertext (decrypt). */
+    uint8_t *out;               /* Ciphertext (encrypt) or plaintext (decrypt). */
+    uint32_t len;               /* Message length in bytes. */
+    uint8_t *tag;               /* Tag: written by encrypt, checked by decrypt. */
+    uint32_t tag_len;           /* 4 to 16 bytes, even. */
+    int status;                 /* Set to 0 on success or -1 for this message. */
+} aes128_ccm_msg;
+
+int aes128_ccm_init(aes128_ccm_ctx *c, const uint8_t *key, uint32_t key_len);
+
+int aes128_ccm_encrypt_ctx(const aes128_ccm_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                           uint8_t *crypt, uint8_t *tag, uint32_t tag_len);
+
+int aes128_ccm_decrypt_ctx(const aes128_ccm_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                           const uint8_t *tag, uint32_t tag_len, uint8_t *plain);
+
+int aes128_ccm_encrypt_batch(const aes128_ccm_ctx *c, aes128_ccm_msg *msgs, size_t n);
+
+int aes128_ccm_decrypt_batch(const aes128_ccm_ctx *c, aes128_ccm_msg *msgs, size_t n);
+
 int aes128_ccm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
                        const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
                        uint8_t *crypt, uint8_t *tag, uint32_t tag_len);
@@ -0,0 +1,108 @@
+/**
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/> */
+
+
+#ifndef AES128_CMAC_H
+#define AES128_CMAC_H
+
+#include <aes128_ecb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * CMAC key context (NIST SP 800-38B; OMAC1): the expanded key and the
+ * subkeys K1 = 2L and K2 = 4L for L = E(K, 0).
+ */
+typedef struct _aes128_cmac_ctx {
+    aes128_key key;
+    uint8_t k1[AES_BLK_LEN];    /* Subkey for a final full block. */
+    uint8_t k2[AES_BLK_LEN];    /* Subkey for a final padded block. */
+} aes128_cmac_ctx;
+
+/**
+ * CMAC chaining state after some input. It is plain data and does not
+ * refer to the key: save it after a prefix shared by many messages
+ * (a common header) and resume each message from it.
+ */
+typedef struct _aes128_cmac_state {
+    uint8_t y[AES_BLK_LEN];     /* CBC-MAC chaining value. */
+    uint8_t buf[AES_BLK_LEN];   /* Last 1..16 input bytes, not yet chained. */
+    uint32_t buf_len;           /* Bytes held in buf; 0 only before any input. */
+} aes128_cmac_state;
+
+/**
+ * One CMAC computation in progress, for input that arrives in pieces.
+ */
+typedef struct _aes128_cmac_stream {
+    const aes128_cmac_ctx *cmac;
+    aes128_cmac_state st;
+} aes128_cmac_stream;
+
+/**
+ * One message of a batch for aes128_cmac_sign_batch() and
+ * aes128_cmac_verify_batch().
+ */
+typedef struct _aes128_cmac_msg {
+    const aes128_cmac_state *prefix;    /* State to resume from, or NULL to start empty. */
+    const uint8_t *in;          /* Message, or the part after the prefix. */
+    size_t len;                 /* Length of in in bytes. */
+    uint8_t *tag;               /* Tag: written by sign, checked by verify. */
+    uint32_t tag_len;           /* Tag length in bytes, 1..16. */
+    int status;                 /* Set to 0 on success or -1 for this message. */
+} aes128_cmac_msg;
+
+int aes128_cmac_init(aes128_cmac_ctx *c, const uint8_t *key, uint32_t key_len);
+
+int aes128_cmac_stream_init(aes128_cmac_stream *s, const aes128_cmac_ctx *c);
+
+int aes128_cmac_stream_update(aes128_cmac_stream *s, const uint8_t *in, size_t len);
+
+int aes128_cmac_stream_final(const aes128_cmac_stream *s, uint8_t *tag);
+
+int aes128_cmac_stream_verify(const aes128_cmac_stream *s, const uint8_t *tag, uint32_t tag_len);
+
+void aes128_cmac_stream_save(const aes128_cmac_stream *s, aes128_cmac_state *st);
+
+void aes128_cmac_stream_restore(aes128_cmac_stream *s, const aes128_cmac_ctx *c, const aes128_cmac_state *st);
+
+int aes128_cmac_sign(const aes128_cmac_ctx *c, const uint8_t *in, size_t len, uint8_t *tag);
+
+int aes128_cmac_verify(const aes128_cmac_ctx *c, const uint8_t *in, size_t len,
+                       const uint8_t *tag, uint32_t tag_len);
+
+int aes128_cmac_sign_batch(const aes128_cmac_ctx *c, aes128_cmac_msg *msgs, size_t n);
+
+int aes128_cmac_verify_batch(const aes128_cmac_ctx *c, aes128_cmac_msg *msgs, size_t n);
+
+int aes128_cmac(const uint8_t *key, uint32_t key_len, const uint8_t *in, size_t len, uint8_t *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
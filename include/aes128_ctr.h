@@ -37,6 +37,10 @@ void aes128_ctr_set(aes128_ctx* c, const void* nonce);
 int aes128_ctr_encrypt(aes128_ctx* c, void* data,  uint32_t len);
 int aes128_ctr_decrypt(aes128_ctx* c, void* data,  uint32_t len);
 
+void aes128_ctr_set_stream(aes128_stream* s, const void* nonce);
+int aes128_ctr_encrypt_stream(aes128_stream* s, void* data, uint32_t len);
+int aes128_ctr_decrypt_stream(aes128_stream* s, void* data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
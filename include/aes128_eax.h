@@ -27,12 +27,69 @@
 #ifndef AES128_EAX_H
 #define AES128_EAX_H
 
-#include <aes128_ecb.h>
+#include <aes128_cmac.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * EAX key context: the CMAC context and the OMAC values that depend on
+ * the key alone.
+ */
+typedef struct _aes128_eax_ctx {
+    aes128_cmac_ctx cmac;               /* Key schedule and CMAC subkeys. */
+    uint8_t tweak[3][AES_BLK_LEN];      /* E(K, [t]): OMAC^t state after the tweak block. */
+    uint8_t empty[3][AES_BLK_LEN];      /* OMAC^t of the empty string. */
+} aes128_eax_ctx;
+
+/* aes128_eax_stream.state */
+#define AES128_EAX_STREAM_AAD  0
+#define AES128_EAX_STREAM_DATA 1
+#define AES128_EAX_STREAM_DONE 2
+
+/**
+ * One EAX message in progress, for input that arrives in pieces. It
+ * points at a shared aes128_eax_ctx and carries the OMAC chain, the
+ * counter block and any partial block between calls, so memory use
+ * does not depend on the message length.
+ */
+typedef struct _aes128_eax_stream {
+    const aes128_eax_ctx *eax;
+    uint8_t mask[AES_BLK_LEN];  /* Nonce OMAC, then XOR header OMAC; masks the tag. */
+    uint8_t ctr[AES_BLK_LEN];   /* Next counter block. */
+    uint8_t ks[AES_BLK_LEN];    /* Keystream of the current partial block. */
+    uint8_t y[AES_BLK_LEN];     /* OMAC chain: header, then ciphertext. */
+    uint8_t buf[AES_BLK_LEN];   /* Last 1..16 bytes of AAD or ciphertext, not yet chained. */
+    uint64_t aad_len;           /* AAD bytes so far. */
+    uint64_t len;               /* Message bytes so far. */
+    uint32_t buf_len;           /* Bytes held in buf. */
+    int state;                  /* AES128_EAX_STREAM_*. */
+} aes128_eax_stream;
+
+int aes128_eax_init(aes128_eax_ctx *c, const uint8_t *key, uint32_t key_len);
+
+int aes128_eax_encrypt_ctx(const aes128_eax_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                           uint8_t *crypt, uint8_t *tag);
+
+int aes128_eax_decrypt_ctx(const aes128_eax_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                           const uint8_t *tag, uint8_t *plain);
+
+int aes128_eax_stream_init(aes128_eax_stream *s, const aes128_eax_ctx *c,
+                           const uint8_t *nonce, uint32_t nonce_len);
+
+int aes128_eax_stream_aad(aes128_eax_stream *s, const uint8_t *aad, size_t len);
+
+int aes128_eax_stream_encrypt(aes128_eax_stream *s, const uint8_t *plain, uint8_t *crypt, size_t len);
+
+int aes128_eax_stream_decrypt(aes128_eax_stream *s, const uint8_t *crypt, uint8_t *plain, size_t len);
+
+int aes128_eax_stream_final(aes128_eax_stream *s, uint8_t *tag);
+
+int aes128_eax_stream_verify(aes128_eax_stream *s, const uint8_t *tag);
+
 int aes128_eax_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
                        const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
                        uint8_t *crypt, uint8_t *tag);
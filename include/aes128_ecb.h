@@ -32,21 +32,25 @@
 
 #if defined(_MSC_VER)            /* any flavour of MSVC / clang‑cl */
 #   define ALIGN16 __declspec(align(16))
+#   define ALIGN8  __declspec(align(8))
 
 #elif defined(__GNUC__) || defined(__clang__)
         /*  GCC, Clang and their cousins (including ICC when –gcc‑compat)  */
 #   define ALIGN16 __attribute__((aligned(16)))
+#   define ALIGN8  __attribute__((aligned(8)))
 
 #else
     /*  C11/C++11 provide an intrinsic keyword; fall back to that if the
         compiler is neither MSVC nor GCC/Clang but still understands it.   */
 #   if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
 #       define ALIGN16 _Alignas(16)
+#       define ALIGN8  _Alignas(8)
 #   elif defined(__cplusplus) && (__cplusplus >= 201103L)
 #       include <cstddef>         /* alignas */
 #       define ALIGN16 alignas(16)
+#       define ALIGN8  alignas(8)
 #   else
-#       error "ALIGN16: unknown compiler—please add alignment syntax here"
+#       error "ALIGN16/ALIGN8: unknown compiler—please add alignment syntax here"
 #   endif
 #endif
 
@@ -67,6 +71,8 @@ static inline void unpack32(uint32_t v, uint8_t *p) {
 }
 
 #define AES_KEY_LEN 16
+#define AES_MAX_KEY_LEN 32
+#define AES_MAX_ROUNDS  14
 #define AES_BLK_LEN 16 
 #define AES_IV_LEN  16
 #define AES_CTR_LEN 16
@@ -85,15 +91,32 @@ typedef union _aes_key_t {
     uint64_t q[AES_KEY_LEN/8];
 } aes_key_t;
 
+/* Expanded key. Written once by aes128_key_expand() and read-only after
+   that, so it can be shared by many threads and streams without locking.
+   The same holds for the mode key contexts built on it (aes128_gcm_ctx,
+   aes128_ccm_ctx, aes128_cmac_ctx, ...): once their init call returns,
+   nothing writes them again. */
+typedef struct _aes128_key {
+    aes_key_t rkeys[AES_MAX_ROUNDS + 1];
+    aes_key_t dkeys[AES_MAX_ROUNDS + 1];    /* equivalent inverse cipher schedule */
+    uint32_t rounds;        /* 10, 12 or 14 for 128, 192 or 256-bit keys */
+    uint32_t impl;          /* round engine picked by aes128_key_expand() */
+    uint64_t bskeys[(AES_MAX_ROUNDS + 1) * 8];  /* bitsliced rkeys (constant-time C engine) */
+} aes128_key;
+
 typedef struct _aes128_ctx {
-    uint8_t sbox[256];
-    uint8_t sbox_inv[256];
-    
     uint8_t ctr[AES_CTR_LEN];
     uint8_t iv[AES_IV_LEN];
-    aes_key_t rkeys[11];
+    aes128_key key;
 } aes128_ctx;
 
+/* Per-stream mode state referencing a shared expanded key */
+typedef struct _aes128_stream {
+    const aes128_key *key;
+    uint8_t ctr[AES_CTR_LEN];
+    uint8_t iv[AES_IV_LEN];
+} aes128_stream;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -114,6 +137,39 @@ aes128_ecb_encrypt(aes128_ctx*, void*);
 void 
 aes128_ecb_decrypt(aes128_ctx*, void*);
 
+void
+aes128_ecb_encrypt_blocks(aes128_ctx*, const void* in, void* out, uint32_t nblocks);
+
+void
+aes128_ecb_decrypt_blocks(aes128_ctx*, const void* in, void* out, uint32_t nblocks);
+
+void
+aes128_key_expand(aes128_key*, const void*);
+
+int
+aes128_key_expand_len(aes128_key*, const void* key, uint32_t key_len);
+
+int
+aes128_set_key_len(aes128_ctx*, const void* key, uint32_t key_len);
+
+void
+aes128_key_encrypt(const aes128_key*, void*);
+
+void
+aes128_key_decrypt(const aes128_key*, void*);
+
+void
+aes128_key_encrypt_blocks(const aes128_key*, const void* in, void* out, uint32_t nblocks);
+
+void
+aes128_key_decrypt_blocks(const aes128_key*, const void* in, void* out, uint32_t nblocks);
+
+void
+aes128_stream_init(aes128_stream*, const aes128_key*);
+
+void
+aes128_stream_set_iv(aes128_stream*, const void*);
+
 #ifdef __cplusplus
 }
 #endif
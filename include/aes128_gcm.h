@@ -33,14 +33,178 @@
 extern "C" {
 #endif
 
+/* Powers of H kept for GHASH and POLYVAL; blocks are folded this many
+   at a time between reductions. */
+#define AES_GF_POWERS 8
+
+/**
+ * GHASH/POLYVAL key: H, H^2 .. H^8 as 128-bit field elements (low
+ * 64 bits first) and the multiply engine chosen for this CPU. The
+ * powers above H are only filled in for the PCLMULQDQ engine.
+ */
+typedef struct _aes128_gf_key {
+    uint64_t h[AES_GF_POWERS][2];
+    uint32_t impl;
+} aes128_gf_key;
+
+/**
+ * GCM key context: the expanded key and the GHASH key for the hash
+ * subkey H.
+ */
+typedef struct _aes128_gcm_ctx {
+    aes128_key key;
+    aes128_gf_key gf;
+} aes128_gcm_ctx;
+
+/**
+ * GHASH midstate over a block-aligned AAD prefix that many messages
+ * share, from aes128_gcm_prefix_init(). Messages started from it only
+ * hash the rest of their AAD and their payload. Tied to the context it
+ * was made with.
+ */
+typedef struct _aes128_gcm_prefix {
+    uint8_t s[AES_BLK_LEN];     /* GHASH over the prefix. */
+    uint64_t len;               /* Prefix length in bytes, a multiple of 16. */
+} aes128_gcm_prefix;
+
+/**
+ * Deterministic 96-bit IVs for one key (SP 800-38D 8.2.1, RFC 5116
+ * 3.2): a 4-byte fixed field, then a 64-bit big-endian invocation
+ * counter. Counter values are claimed with an atomic add, so threads
+ * sharing a generator need no lock, and each is handed out once, up to
+ * limit. The counter is 8-byte aligned even on 32-bit ABIs, where a
+ * misaligned 64-bit atomic would need a split lock or a library lock.
+ */
+typedef struct _aes128_gcm_nonce {
+    ALIGN8 uint64_t next;       /* Next counter value; updated atomically. */
+    uint64_t limit;             /* Counter values that may be used. */
+    const aes128_gcm_ctx *gcm;  /* Key the IVs are for. */
+    uint8_t fixed[4];           /* Fixed field, e.g. a device or thread ID. */
+} aes128_gcm_nonce;
+
+/**
+ * A block of counter values reserved from an aes128_gcm_nonce, to be
+ * used by one thread without touching the shared counter.
+ */
+typedef struct _aes128_gcm_nonce_range {
+    uint64_t next;              /* Next counter value. */
+    uint64_t end;               /* One past the last reserved value. */
+    const aes128_gcm_ctx *gcm;  /* Key the IVs are for. */
+    uint8_t fixed[4];           /* Fixed field of the generator. */
+} aes128_gcm_nonce_range;
+
+/* aes128_gcm_stream.state */
+#define AES128_GCM_STREAM_AAD  0
+#define AES128_GCM_STREAM_DATA 1
+#define AES128_GCM_STREAM_DONE 2
+
+/**
+ * One GCM message in progress, for input that arrives in pieces. It
+ * points at a shared aes128_gcm_ctx and carries the GHASH accumulator,
+ * the counter block and any partial block between calls, so memory use
+ * does not depend on the message length.
+ */
+typedef struct _aes128_gcm_stream {
+    const aes128_gcm_ctx *gcm;
+    uint8_t j0[AES_BLK_LEN];    /* Pre-counter block; masks the tag. */
+    uint8_t ctr[AES_BLK_LEN];   /* Next counter block. */
+    uint8_t ks[AES_BLK_LEN];    /* Keystream of the current partial block. */
+    uint8_t s[AES_BLK_LEN];     /* GHASH accumulator. */
+    uint8_t buf[AES_BLK_LEN];   /* AAD or ciphertext not yet hashed. */
+    uint64_t aad_len;           /* AAD bytes so far. */
+    uint64_t len;               /* Message bytes so far. */
+    uint32_t buf_len;           /* Bytes held in buf. */
+    int state;                  /* AES128_GCM_STREAM_*. */
+} aes128_gcm_stream;
+
+/**
+ * One message of a batch for aes128_gcm_encrypt_batch() and
+ * aes128_gcm_decrypt_batch(). in and out may be the same buffer.
+ */
+typedef struct _aes128_gcm_msg {
+    const uint8_t *iv;          /* Nonce. */
+    uint32_t iv_len;            /* Nonce length in bytes. */
+    const uint8_t *aad;         /* Additional authenticated data. */
+    size_t aad_len;             /* AAD length in bytes. */
+    const uint8_t *in;          /* Plaintext (encrypt) or ciphertext (decrypt). */
+    uint8_t *out;               /* Ciphertext (encrypt) or plaintext (decrypt). */
+    size_t len;                 /* Message length in bytes. */
+    uint8_t *tag;               /* 16-byte tag: written by encrypt, checked by decrypt. */
+    int status;                 /* Set to 0 on success or -1 for this message. */
+} aes128_gcm_msg;
+
+int aes128_gcm_init(aes128_gcm_ctx *c, const uint8_t *key, uint32_t key_len);
+
+int aes128_gcm_encrypt_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+	       const uint8_t *plain, size_t plain_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t *tag);
+
+int aes128_gcm_decrypt_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+	       const uint8_t *crypt, size_t crypt_len,
+	       const uint8_t *aad, size_t aad_len, const uint8_t *tag, uint8_t *plain);
+
+int aes128_gcm_prefix_init(const aes128_gcm_ctx *c, aes128_gcm_prefix *p,
+	       const uint8_t *aad, size_t len);
+
+int aes128_gcm_encrypt_prefix(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p,
+	       const uint8_t *iv, uint32_t iv_len, const uint8_t *plain, size_t plain_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t *tag);
+
+int aes128_gcm_decrypt_prefix(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p,
+	       const uint8_t *iv, uint32_t iv_len, const uint8_t *crypt, size_t crypt_len,
+	       const uint8_t *aad, size_t aad_len, const uint8_t *tag, uint8_t *plain);
+
+int aes128_gmac_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *tag);
+
+int aes128_gmac_parallel(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+	       const uint8_t *aad, size_t aad_len, uint32_t threads, uint8_t *tag);
+
+int aes128_gcm_nonce_init(aes128_gcm_nonce *n, const aes128_gcm_ctx *c,
+	       const uint8_t fixed[4], uint64_t limit);
+
+int aes128_gcm_nonce_next(aes128_gcm_nonce *n, uint8_t iv[12]);
+
+int aes128_gcm_nonce_reserve(aes128_gcm_nonce *n, uint64_t count, aes128_gcm_nonce_range *r);
+
+int aes128_gcm_nonce_range_next(aes128_gcm_nonce_range *r, uint8_t iv[12]);
+
+int aes128_gcm_encrypt_next(aes128_gcm_nonce *n, const uint8_t *plain, size_t plain_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t iv[12], uint8_t *tag);
+
+int aes128_gcm_encrypt_range(aes128_gcm_nonce_range *r, const uint8_t *plain, size_t plain_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t iv[12], uint8_t *tag);
+
+int aes128_gcm_encrypt_batch(const aes128_gcm_ctx *c, aes128_gcm_msg *msgs, size_t n);
+
+int aes128_gcm_decrypt_batch(const aes128_gcm_ctx *c, aes128_gcm_msg *msgs, size_t n);
+
+int aes128_gcm_stream_init(aes128_gcm_stream *s, const aes128_gcm_ctx *c,
+	       const uint8_t *iv, uint32_t iv_len);
+
+int aes128_gcm_stream_aad(aes128_gcm_stream *s, const uint8_t *aad, size_t len);
+
+int aes128_gcm_stream_prefix(aes128_gcm_stream *s, const aes128_gcm_prefix *p);
+
+int aes128_gcm_stream_encrypt(aes128_gcm_stream *s, const uint8_t *plain, uint8_t *crypt, size_t len);
+
+int aes128_gcm_stream_decrypt(aes128_gcm_stream *s, const uint8_t *crypt, uint8_t *plain, size_t len);
+
+int aes128_gcm_stream_final(aes128_gcm_stream *s, uint8_t *tag);
+
+int aes128_gcm_stream_verify(aes128_gcm_stream *s, const uint8_t *tag);
+
 int aes128_gcm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
-	       const uint8_t *plain, uint32_t plain_len,
-	       const uint8_t *aad, uint32_t aad_len, uint8_t *crypt, uint8_t *tag);
+	       const uint8_t *plain, size_t plain_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t *tag);
            
 int aes128_gcm_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
-	       const uint8_t *crypt, uint32_t crypt_len,
-	       const uint8_t *aad, uint32_t aad_len, const uint8_t *tag, uint8_t *plain);
+	       const uint8_t *crypt, size_t crypt_len,
+	       const uint8_t *aad, size_t aad_len, const uint8_t *tag, uint8_t *plain);
            
+int aes128_gmac(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
+	       const uint8_t *aad, size_t aad_len, uint8_t *tag);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,12 +33,31 @@
 extern "C" {
 #endif
 
+/**
+ * GCM-SIV key context: the key schedule of the key-generating key,
+ * from which each message's keys are derived.
+ */
+typedef struct _aes128_gcm_siv_ctx {
+    aes128_key key;
+    uint32_t key_len;           /* 16 or 32. */
+} aes128_gcm_siv_ctx;
+
+int aes128_gcm_siv_init(aes128_gcm_siv_ctx *c, const uint8_t *key, uint32_t key_len);
+
+int aes128_gcm_siv_encrypt_ctx(const aes128_gcm_siv_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                               const uint8_t *aad, size_t aad_len, const uint8_t *plain, size_t plain_len,
+                               uint8_t *crypt, uint8_t *tag);
+
+int aes128_gcm_siv_decrypt_ctx(const aes128_gcm_siv_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                               const uint8_t *aad, size_t aad_len, const uint8_t *crypt, size_t crypt_len,
+                               const uint8_t *tag, uint8_t *plain);
+
 int aes128_gcm_siv_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                           const uint8_t *aad, size_t aad_len, const uint8_t *plain, size_t plain_len,
                            uint8_t *crypt, uint8_t *tag);
 
 int aes128_gcm_siv_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                           const uint8_t *aad, size_t aad_len, const uint8_t *crypt, size_t crypt_len,
                            const uint8_t *tag, uint8_t *plain);
 
 #ifdef __cplusplus
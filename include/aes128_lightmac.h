@@ -47,7 +47,7 @@ extern "C" {
  * - t_bits: tag length in bits (must be multiple of 8, 8..128)
  */
 typedef struct _aes128_lightmac_ctx {
-    aes128_ctx aes;         /* AES-128 context (sbox + round keys); initialized by aes128_init_ctx(). */
+    aes128_ctx aes;         /* AES-128 context (round keys); keyed by the LightMAC calls. */
     uint8_t k1[AES_KEY_LEN];/* K1 key bytes (16 bytes); caller provides any 16-byte value. */
     uint8_t k2[AES_KEY_LEN];/* K2 key bytes (16 bytes); caller provides any 16-byte value. */
     uint8_t v[AES_BLK_LEN]; /* Accumulator V (16 bytes); internal state, do not modify directly. */
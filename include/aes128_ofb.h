@@ -39,6 +39,12 @@ aes128_ofb_encrypt(aes128_ctx* c, void* data,  uint32_t len);
 void 
 aes128_ofb_decrypt(aes128_ctx* c, void* data,  uint32_t len);
 
+void
+aes128_ofb_encrypt_stream(aes128_stream* s, void* data, uint32_t len);
+
+void
+aes128_ofb_decrypt_stream(aes128_stream* s, void* data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
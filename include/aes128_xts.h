@@ -38,6 +38,11 @@ int aes128_xts_encrypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
 int aes128_xts_decrypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
                        const void* tweak, void* data, uint32_t len);
 
+int aes128_xts_encrypt_key(const aes128_key* data_key, const aes128_key* tweak_key,
+                           const void* tweak, void* data, uint32_t len);
+int aes128_xts_decrypt_key(const aes128_key* data_key, const aes128_key* tweak_key,
+                           const void* tweak, void* data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,209 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+/*
+ * AES-NI round engine.
+ *
+ * Round keys are kept in the same byte order as the portable key schedule,
+ * so a context expanded here can be used by any other engine and vice versa.
+ */
+
+static inline __m128i aes_ni_expand(__m128i k, __m128i kg) {
+    kg = _mm_shuffle_epi32(kg, _MM_SHUFFLE(3, 3, 3, 3));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    return _mm_xor_si128(k, kg);
+}
+
+#define EXPAND(i, rc) \
+    k = aes_ni_expand(k, _mm_aeskeygenassist_si128(k, rc)); \
+    _mm_storeu_si128((__m128i*)&rk[i], k)
+
+/**
+ * Creates the 11 AES-128 round keys with AESKEYGENASSIST, and the
+ * equivalent inverse cipher schedule in dk with AESIMC.
+ */
+void aes_ni_set_key(aes_key_t *rk, aes_key_t *dk, const void *key) {
+    __m128i k = _mm_loadu_si128((const __m128i*)key);
+
+    _mm_storeu_si128((__m128i*)&rk[0], k);
+    EXPAND(1, 0x01);
+    EXPAND(2, 0x02);
+    EXPAND(3, 0x04);
+    EXPAND(4, 0x08);
+    EXPAND(5, 0x10);
+    EXPAND(6, 0x20);
+    EXPAND(7, 0x40);
+    EXPAND(8, 0x80);
+    EXPAND(9, 0x1b);
+    EXPAND(10, 0x36);
+
+    _mm_storeu_si128((__m128i*)&dk[0], k);
+    for (int i = 1; i < 10; i++) {
+        _mm_storeu_si128((__m128i*)&dk[i], _mm_aesimc_si128(_mm_loadu_si128((const __m128i*)&rk[10 - i])));
+    }
+    _mm_storeu_si128((__m128i*)&dk[10], _mm_loadu_si128((const __m128i*)&rk[0]));
+}
+
+/**
+ * Applies SubBytes to the four bytes of a key schedule word. Used to
+ * expand 192 and 256-bit keys, whose schedules do not fit the fixed
+ * AESKEYGENASSIST pattern above.
+ */
+uint32_t aes_ni_sub_word(uint32_t w) {
+    __m128i x = _mm_aeskeygenassist_si128(_mm_set1_epi32((int)w), 0);
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+/**
+ * Encrypts a single 16-byte block in-place with the nr + 1 round keys in rk.
+ */
+void aes_ni_encrypt(const aes_key_t *rk, uint32_t nr, void *data) {
+    __m128i x = _mm_loadu_si128((const __m128i*)data);
+
+    x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)&rk[0]));
+    for (uint32_t i = 1; i < nr; i++) {
+        x = _mm_aesenc_si128(x, _mm_loadu_si128((const __m128i*)&rk[i]));
+    }
+    x = _mm_aesenclast_si128(x, _mm_loadu_si128((const __m128i*)&rk[nr]));
+    _mm_storeu_si128((__m128i*)data, x);
+}
+
+/**
+ * Decrypts a single 16-byte block in-place with the equivalent inverse
+ * cipher schedule in dk.
+ */
+void aes_ni_decrypt(const aes_key_t *dk, uint32_t nr, void *data) {
+    __m128i x = _mm_loadu_si128((const __m128i*)data);
+
+    x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)&dk[0]));
+    for (uint32_t i = 1; i < nr; i++) {
+        x = _mm_aesdec_si128(x, _mm_loadu_si128((const __m128i*)&dk[i]));
+    }
+    x = _mm_aesdeclast_si128(x, _mm_loadu_si128((const __m128i*)&dk[nr]));
+    _mm_storeu_si128((__m128i*)data, x);
+}
+
+#define RK(i) _mm_loadu_si128((const __m128i*)&rk[i])
+
+/* Applies one round function with key k to eight independent blocks */
+#define ROUND8(op, x, k) \
+    x[0] = op(x[0], k); x[1] = op(x[1], k); x[2] = op(x[2], k); x[3] = op(x[3], k); \
+    x[4] = op(x[4], k); x[5] = op(x[5], k); x[6] = op(x[6], k); x[7] = op(x[7], k)
+
+/**
+ * Encrypts n blocks from in to out. Eight blocks are kept in flight so the
+ * multi-cycle latency of AESENC is overlapped; the remainder goes two at
+ * a time, then one.
+ */
+void aes_ni_encrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    __m128i x[8], k;
+
+    for (; n >= 8; n -= 8) {
+        k = RK(0);
+        for (int j = 0; j < 8; j++) {
+            x[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 16 * j)), k);
+        }
+        for (uint32_t i = 1; i < nr; i++) {
+            k = RK(i);
+            ROUND8(_mm_aesenc_si128, x, k);
+        }
+        k = RK(nr);
+        ROUND8(_mm_aesenclast_si128, x, k);
+        for (int j = 0; j < 8; j++) {
+            _mm_storeu_si128((__m128i*)(out + 16 * j), x[j]);
+        }
+        in  += 8 * AES_BLK_LEN;
+        out += 8 * AES_BLK_LEN;
+    }
+    /* Pairs: the fused MAC + keystream calls of CCM and EAX land here */
+    for (; n >= 2; n -= 2) {
+        k = RK(0);
+        x[0] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), k);
+        x[1] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 16)), k);
+        for (uint32_t i = 1; i < nr; i++) {
+            k = RK(i);
+            x[0] = _mm_aesenc_si128(x[0], k);
+            x[1] = _mm_aesenc_si128(x[1], k);
+        }
+        k = RK(nr);
+        _mm_storeu_si128((__m128i*)out, _mm_aesenclast_si128(x[0], k));
+        _mm_storeu_si128((__m128i*)(out + 16), _mm_aesenclast_si128(x[1], k));
+        in  += 2 * AES_BLK_LEN;
+        out += 2 * AES_BLK_LEN;
+    }
+    for (; n > 0; n--) {
+        __m128i y = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), RK(0));
+        for (uint32_t i = 1; i < nr; i++) {
+            y = _mm_aesenc_si128(y, RK(i));
+        }
+        _mm_storeu_si128((__m128i*)out, _mm_aesenclast_si128(y, RK(nr)));
+        in  += AES_BLK_LEN;
+        out += AES_BLK_LEN;
+    }
+}
+
+/**
+ * Decrypts n blocks from in to out, eight at a time, with the equivalent
+ * inverse cipher schedule in dk.
+ */
+void aes_ni_decrypt_blocks(const aes_key_t *dk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    __m128i x[8], k;
+
+    for (; n >= 8; n -= 8) {
+        k = _mm_loadu_si128((const __m128i*)&dk[0]);
+        for (int j = 0; j < 8; j++) {
+            x[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 16 * j)), k);
+        }
+        for (uint32_t i = 1; i < nr; i++) {
+            k = _mm_loadu_si128((const __m128i*)&dk[i]);
+            ROUND8(_mm_aesdec_si128, x, k);
+        }
+        k = _mm_loadu_si128((const __m128i*)&dk[nr]);
+        ROUND8(_mm_aesdeclast_si128, x, k);
+        for (int j = 0; j < 8; j++) {
+            _mm_storeu_si128((__m128i*)(out + 16 * j), x[j]);
+        }
+        in  += 8 * AES_BLK_LEN;
+        out += 8 * AES_BLK_LEN;
+    }
+    for (; n > 0; n--) {
+        __m128i y = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128((const __m128i*)&dk[0]));
+        for (uint32_t i = 1; i < nr; i++) {
+            y = _mm_aesdec_si128(y, _mm_loadu_si128((const __m128i*)&dk[i]));
+        }
+        _mm_storeu_si128((__m128i*)out, _mm_aesdeclast_si128(y, _mm_loadu_si128((const __m128i*)&dk[nr])));
+        in  += AES_BLK_LEN;
+        out += AES_BLK_LEN;
+    }
+}
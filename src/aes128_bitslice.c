@@ -0,0 +1,440 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+/*
+ * Constant-time bitsliced AES.
+ *
+ * Four blocks are processed together in eight 64-bit words: word k holds
+ * bit k of all 64 state bytes. Within a word, bit (16*r + 4*c + b) is row r,
+ * column c of block b, so ShiftRows is a rotation inside each 16-bit row
+ * and MixColumns is a rotation of whole rows. SubBytes is the Boyar-Peralta
+ * circuit, evaluated on all 64 bytes at once. No memory access and no
+ * branch depends on key or data.
+ */
+
+#define SWAPMOVE(a, b, m, n) do { \
+    uint64_t t_ = (((a) >> (n)) ^ (b)) & (m); \
+    (b) ^= t_; \
+    (a) ^= t_ << (n); \
+} while (0)
+
+/* 8x8 bit transpose across the eight words; its own inverse. */
+static void bs_ortho(uint64_t *q) {
+    SWAPMOVE(q[0], q[1], 0x5555555555555555ULL, 1);
+    SWAPMOVE(q[2], q[3], 0x5555555555555555ULL, 1);
+    SWAPMOVE(q[4], q[5], 0x5555555555555555ULL, 1);
+    SWAPMOVE(q[6], q[7], 0x5555555555555555ULL, 1);
+
+    SWAPMOVE(q[0], q[2], 0x3333333333333333ULL, 2);
+    SWAPMOVE(q[1], q[3], 0x3333333333333333ULL, 2);
+    SWAPMOVE(q[4], q[6], 0x3333333333333333ULL, 2);
+    SWAPMOVE(q[5], q[7], 0x3333333333333333ULL, 2);
+
+    SWAPMOVE(q[0], q[4], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAPMOVE(q[1], q[5], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAPMOVE(q[2], q[6], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAPMOVE(q[3], q[7], 0x0F0F0F0F0F0F0F0FULL, 4);
+}
+
+/* Load four blocks into bitsliced form. */
+static void bs_load(uint64_t *q, const uint8_t *b0, const uint8_t *b1,
+                    const uint8_t *b2, const uint8_t *b3) {
+    const uint8_t *blk[4];
+    blk[0] = b0; blk[1] = b1; blk[2] = b2; blk[3] = b3;
+
+    /* Byte p of word (4*(c & 1) + b) is row p/2, column 2*(p & 1) + (c & 1). */
+    for (uint32_t w = 0; w < 8; w++) {
+        const uint8_t *s = blk[w & 3];
+        uint32_t cp = w >> 2;
+        uint64_t x = 0;
+        for (uint32_t p = 0; p < 8; p++) {
+            uint32_t r = p >> 1, c = ((p & 1) << 1) | cp;
+            x |= (uint64_t)s[c * 4 + r] << (8 * p);
+        }
+        q[w] = x;
+    }
+    bs_ortho(q);
+}
+
+/* Store four blocks from bitsliced form (destroys q). */
+static void bs_store(uint64_t *q, uint8_t *b0, uint8_t *b1, uint8_t *b2, uint8_t *b3) {
+    uint8_t *blk[4];
+    blk[0] = b0; blk[1] = b1; blk[2] = b2; blk[3] = b3;
+
+    bs_ortho(q);
+    for (uint32_t w = 0; w < 8; w++) {
+        uint8_t *d = blk[w & 3];
+        uint32_t cp = w >> 2;
+        uint64_t x = q[w];
+        for (uint32_t p = 0; p < 8; p++) {
+            uint32_t r = p >> 1, c = ((p & 1) << 1) | cp;
+            d[c * 4 + r] = (uint8_t)(x >> (8 * p));
+        }
+    }
+}
+
+/* SubBytes on all 64 bytes: Boyar-Peralta S-box circuit. */
+static void bs_sbox(uint64_t *q) {
+    uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint64_t y20, y21;
+    uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+    x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+    // Top linear transformation
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    // Non-linear section
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    // Bottom linear transformation
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+    q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+}
+
+/* Inverse affine map G(v) = L^-1(v) ^ 0x05, so that InvSubBytes = G o S o G. */
+static void bs_inv_affine(uint64_t *q) {
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+
+    q[0] = ~(q2 ^ q5 ^ q7);
+    q[1] = q3 ^ q6 ^ q0;
+    q[2] = ~(q4 ^ q7 ^ q1);
+    q[3] = q5 ^ q0 ^ q2;
+    q[4] = q6 ^ q1 ^ q3;
+    q[5] = q7 ^ q2 ^ q4;
+    q[6] = q0 ^ q3 ^ q5;
+    q[7] = q1 ^ q4 ^ q6;
+}
+
+static void bs_inv_sbox(uint64_t *q) {
+    bs_inv_affine(q);
+    bs_sbox(q);
+    bs_inv_affine(q);
+}
+
+static void bs_shift_rows(uint64_t *q) {
+    for (uint32_t i = 0; i < 8; i++) {
+        uint64_t x = q[i];
+        q[i] = (x & 0x000000000000FFFFULL)
+             | ((x & 0x00000000FFF00000ULL) >> 4)
+             | ((x & 0x00000000000F0000ULL) << 12)
+             | ((x & 0x0000FF0000000000ULL) >> 8)
+             | ((x & 0x000000FF00000000ULL) << 8)
+             | ((x & 0xF000000000000000ULL) >> 12)
+             | ((x & 0x0FFF000000000000ULL) << 4);
+    }
+}
+
+static void bs_inv_shift_rows(uint64_t *q) {
+    for (uint32_t i = 0; i < 8; i++) {
+        uint64_t x = q[i];
+        q[i] = (x & 0x000000000000FFFFULL)
+             | ((x & 0x000000000FFF0000ULL) << 4)
+             | ((x & 0x00000000F0000000ULL) >> 12)
+             | ((x & 0x0000FF0000000000ULL) >> 8)
+             | ((x & 0x000000FF00000000ULL) << 8)
+             | ((x & 0x000F000000000000ULL) << 12)
+             | ((x & 0xFFF0000000000000ULL) >> 4);
+    }
+}
+
+static inline uint64_t rot_row(uint64_t x) {
+    return (x >> 16) | (x << 48);
+}
+
+static inline uint64_t rot_2rows(uint64_t x) {
+    return (x >> 32) | (x << 32);
+}
+
+static void bs_mix_columns(uint64_t *q) {
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    uint64_t r0 = rot_row(q0), r1 = rot_row(q1), r2 = rot_row(q2), r3 = rot_row(q3);
+    uint64_t r4 = rot_row(q4), r5 = rot_row(q5), r6 = rot_row(q6), r7 = rot_row(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ rot_2rows(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rot_2rows(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ rot_2rows(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rot_2rows(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rot_2rows(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ rot_2rows(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ rot_2rows(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ rot_2rows(q7 ^ r7);
+}
+
+/* InvMixColumns = MixColumns o (x ^ 4*(x ^ rows+2)), as in aes128_ecb.c */
+static void bs_inv_mix_columns(uint64_t *q) {
+    uint64_t t[8];
+
+    for (uint32_t i = 0; i < 8; i++) {
+        t[i] = q[i] ^ rot_2rows(q[i]);
+    }
+    q[0] ^= t[6];
+    q[1] ^= t[6] ^ t[7];
+    q[2] ^= t[0] ^ t[7];
+    q[3] ^= t[1] ^ t[6];
+    q[4] ^= t[2] ^ t[6] ^ t[7];
+    q[5] ^= t[3] ^ t[7];
+    q[6] ^= t[4];
+    q[7] ^= t[5];
+    bs_mix_columns(q);
+}
+
+static inline void bs_add_round_key(uint64_t *q, const uint64_t *sk) {
+    for (uint32_t i = 0; i < 8; i++) {
+        q[i] ^= sk[i];
+    }
+}
+
+/**
+ * Bitslices the nr + 1 round keys, each replicated across the four lanes.
+ */
+void aes_bs_set_key(uint64_t *sk, const aes_key_t *rk, uint32_t nr) {
+    uint8_t k[AES_BLK_LEN];
+
+    for (uint32_t r = 0; r <= nr; r++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            unpack32(rk[r].w[i], k + (i * 4));
+        }
+        bs_load(sk + (r * 8), k, k, k, k);
+    }
+}
+
+/**
+ * Applies SubBytes to the four bytes of a key schedule word.
+ */
+uint32_t aes_bs_sub_word(uint32_t w) {
+    uint64_t q[8];
+    uint8_t b[AES_BLK_LEN] = {0};
+
+    unpack32(w, b);
+    bs_load(q, b, b, b, b);
+    bs_sbox(q);
+    bs_store(q, b, b, b, b);
+    return pack32(b);
+}
+
+/**
+ * Encrypts n independent blocks from in to out, four at a time.
+ * in and out may be the same buffer.
+ */
+void aes_bs_encrypt(const uint64_t *sk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    uint64_t q[8];
+    uint8_t tmp[4][AES_BLK_LEN];
+
+    while (n) {
+        uint32_t m = n < 4 ? n : 4;
+
+        memset(tmp, 0, sizeof tmp);
+        memcpy(tmp, in, m * AES_BLK_LEN);
+        bs_load(q, tmp[0], tmp[1], tmp[2], tmp[3]);
+
+        bs_add_round_key(q, sk);
+        for (uint32_t r = 1; r < nr; r++) {
+            bs_sbox(q);
+            bs_shift_rows(q);
+            bs_mix_columns(q);
+            bs_add_round_key(q, sk + (r * 8));
+        }
+        bs_sbox(q);
+        bs_shift_rows(q);
+        bs_add_round_key(q, sk + (nr * 8));
+
+        bs_store(q, tmp[0], tmp[1], tmp[2], tmp[3]);
+        memcpy(out, tmp, m * AES_BLK_LEN);
+
+        in  += m * AES_BLK_LEN;
+        out += m * AES_BLK_LEN;
+        n   -= m;
+    }
+}
+
+/**
+ * Decrypts n independent blocks from in to out, four at a time, with the
+ * straightforward inverse cipher. in and out may be the same buffer.
+ */
+void aes_bs_decrypt(const uint64_t *sk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    uint64_t q[8];
+    uint8_t tmp[4][AES_BLK_LEN];
+
+    while (n) {
+        uint32_t m = n < 4 ? n : 4;
+
+        memset(tmp, 0, sizeof tmp);
+        memcpy(tmp, in, m * AES_BLK_LEN);
+        bs_load(q, tmp[0], tmp[1], tmp[2], tmp[3]);
+
+        bs_add_round_key(q, sk + (nr * 8));
+        for (uint32_t r = nr - 1; r > 0; r--) {
+            bs_inv_shift_rows(q);
+            bs_inv_sbox(q);
+            bs_add_round_key(q, sk + (r * 8));
+            bs_inv_mix_columns(q);
+        }
+        bs_inv_shift_rows(q);
+        bs_inv_sbox(q);
+        bs_add_round_key(q, sk);
+
+        bs_store(q, tmp[0], tmp[1], tmp[2], tmp[3]);
+        memcpy(out, tmp, m * AES_BLK_LEN);
+
+        in  += m * AES_BLK_LEN;
+        out += m * AES_BLK_LEN;
+        n   -= m;
+    }
+}
@@ -26,17 +26,12 @@
  */
 
 #include <aes128_cbc.h>
+#include "aes128_impl.h"
 
-/**
- * Encrypts data in-place using AES-128 in CBC mode.
- *
- * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
- * @param data  Pointer to the data buffer (plaintext) to encrypt.
- * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
- */
-int aes128_cbc_encrypt(aes128_ctx* c, void* data, uint32_t len) {
+/* CBC encryption with key k, chaining through the 16-byte iv */
+static int cbc_encrypt(const aes128_key* k, uint8_t* iv, void* data, uint32_t len) {
     uint8_t *buf = (uint8_t*)data;
-    uint8_t *iv  = c->iv;
+    const uint8_t *prev = iv;
 
     if (len == 0) {
         return 1;
@@ -48,33 +43,31 @@ int aes128_cbc_encrypt(aes128_ctx* c, void* data, uint32_t len) {
     while (len >= AES_BLK_LEN) {
         // XOR the current plaintext block with the IV (or previous ciphertext)
         for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-            buf[i] ^= iv[i];
+            buf[i] ^= prev[i];
         }
         // Encrypt the block in-place using AES-128 ECB
-        aes128_ecb_encrypt(c, buf);
+        aes128_key_encrypt(k, buf);
 
         // Update IV to the ciphertext block just produced
-        iv = buf;
+        prev = buf;
         buf += AES_BLK_LEN;
         len -= AES_BLK_LEN;
     }
 
-    // Update the IV in the AES context
-    for (uint32_t i=0; i<AES_BLK_LEN; i++) c->iv[i] = iv[i];
+    // Update the chaining value
+    for (uint32_t i=0; i<AES_BLK_LEN; i++) iv[i] = prev[i];
     return 1;
 }
 
-
-/**
- * Decrypts data in-place using AES-128 in CBC mode.
+/* CBC decryption with key k, chaining through the 16-byte iv.
  *
- * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
- * @param data  Pointer to the data buffer (ciphertext) to decrypt.
- * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
+ * The block decryptions do not depend on each other, so the ciphertext is
+ * processed in runs of AES_PAR_BLOCKS through the multi-block engine and
+ * chained afterwards.
  */
-int aes128_cbc_decrypt(aes128_ctx* c, void* data, uint32_t len) {
-    uint32_t i;
-    uint8_t tmp[AES_BLK_LEN];
+static int cbc_decrypt(const aes128_key* k, uint8_t* iv, void* data, uint32_t len) {
+    uint32_t i, n;
+    uint8_t tmp[AES_PAR_BLOCKS * AES_BLK_LEN];
     uint8_t *buf = (uint8_t*)data;
 
     if (len == 0) {
@@ -85,18 +78,58 @@ int aes128_cbc_decrypt(aes128_ctx* c, void* data, uint32_t len) {
     }
 
     while (len >= AES_BLK_LEN) {
-        // Save ciphertext before decrypting in-place.
-        for (i = 0; i < AES_BLK_LEN; i++) tmp[i] = buf[i];
-        // Decrypt ciphertext.
-        aes128_ecb_decrypt(c, buf);
-        // XOR with the stored IV (previous ciphertext or initial IV).
-        for (i = 0; i < AES_BLK_LEN; i++) buf[i] ^= c->iv[i];
-        // Advance: current ciphertext becomes next IV.
-        for (i = 0; i < AES_BLK_LEN; i++) c->iv[i] = tmp[i];
-        len -= AES_BLK_LEN;
-        buf += AES_BLK_LEN;
+        n = len / AES_BLK_LEN;
+        if (n > AES_PAR_BLOCKS) {
+            n = AES_PAR_BLOCKS;
+        }
+        // Save the ciphertext run, then decrypt it into place.
+        memcpy(tmp, buf, n * AES_BLK_LEN);
+        aes128_key_decrypt_blocks(k, tmp, buf, n);
+        // XOR with the IV, then with each preceding ciphertext block.
+        for (i = 0; i < AES_BLK_LEN; i++) buf[i] ^= iv[i];
+        for (i = AES_BLK_LEN; i < n * AES_BLK_LEN; i++) buf[i] ^= tmp[i - AES_BLK_LEN];
+        // Advance: last ciphertext of the run becomes next IV.
+        memcpy(iv, tmp + (n - 1) * AES_BLK_LEN, AES_BLK_LEN);
+        len -= n * AES_BLK_LEN;
+        buf += n * AES_BLK_LEN;
     }
     return 1;
 }
 
+/**
+ * Encrypts data in-place using AES-128 in CBC mode.
+ *
+ * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
+ * @param data  Pointer to the data buffer (plaintext) to encrypt.
+ * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
+ */
+int aes128_cbc_encrypt(aes128_ctx* c, void* data, uint32_t len) {
+    return cbc_encrypt(&c->key, c->iv, data, len);
+}
+
+/**
+ * Decrypts data in-place using AES-128 in CBC mode.
+ *
+ * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
+ * @param data  Pointer to the data buffer (ciphertext) to decrypt.
+ * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
+ */
+int aes128_cbc_decrypt(aes128_ctx* c, void* data, uint32_t len) {
+    return cbc_decrypt(&c->key, c->iv, data, len);
+}
+
+/**
+ * Encrypts data in-place using AES-128 in CBC mode on a stream that
+ * references a shared key. Only s->iv is updated.
+ */
+int aes128_cbc_encrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return cbc_encrypt(s->key, s->iv, data, len);
+}
 
+/**
+ * Decrypts data in-place using AES-128 in CBC mode on a stream that
+ * references a shared key. Only s->iv is updated.
+ */
+int aes128_cbc_decrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return cbc_decrypt(s->key, s->iv, data, len);
+}
@@ -27,34 +27,43 @@
 
 #include <aes128_ccm.h>
 #include <string.h>
+#include "aes128_impl.h"
 
-static void xor_block(uint8_t *dst, const uint8_t *src) {
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        dst[i] ^= src[i];
-    }
-}
-
-static void ccm_mac_block(aes128_ctx *ctx, uint8_t y[AES_BLK_LEN], const uint8_t block[AES_BLK_LEN]) {
-    uint8_t tmp[AES_BLK_LEN];
-    memcpy(tmp, block, AES_BLK_LEN);
-    xor_block(tmp, y);
-    aes128_ecb_encrypt(ctx, tmp);
-    memcpy(y, tmp, AES_BLK_LEN);
+static void ccm_mac_block(const aes128_key *key, uint8_t y[AES_BLK_LEN], const uint8_t block[AES_BLK_LEN]) {
+    xor16(y, y, block);
+    aes128_key_encrypt(key, y);
 }
 
-static void ccm_mac_data(aes128_ctx *ctx, uint8_t y[AES_BLK_LEN], const uint8_t *data, uint32_t len) {
+static void ccm_mac_data(const aes128_key *key, uint8_t y[AES_BLK_LEN], const uint8_t *data, uint32_t len) {
     uint8_t block[AES_BLK_LEN];
     while (len) {
         uint32_t n = len > AES_BLK_LEN ? AES_BLK_LEN : len;
         memset(block, 0, AES_BLK_LEN);
         memcpy(block, data, n);
-        ccm_mac_block(ctx, y, block);
+        ccm_mac_block(key, y, block);
         data += n;
         len -= n;
     }
 }
 
-static void ccm_mac_aad(aes128_ctx *ctx, uint8_t y[AES_BLK_LEN], const uint8_t *aad, uint32_t aad_len) {
+/* Writes the encoding of aad_len that precedes the AAD and returns
+   its size, 2 or 6 bytes. */
+static uint32_t ccm_aad_hdr(uint8_t hdr[6], uint32_t aad_len) {
+    if (aad_len < 0xFF00) {
+        hdr[0] = (uint8_t)(aad_len >> 8);
+        hdr[1] = (uint8_t)(aad_len);
+        return 2;
+    }
+    hdr[0] = 0xFF;
+    hdr[1] = 0xFE;
+    hdr[2] = (uint8_t)(aad_len >> 24);
+    hdr[3] = (uint8_t)(aad_len >> 16);
+    hdr[4] = (uint8_t)(aad_len >> 8);
+    hdr[5] = (uint8_t)(aad_len);
+    return 6;
+}
+
+static void ccm_mac_aad(const aes128_key *key, uint8_t y[AES_BLK_LEN], const uint8_t *aad, uint32_t aad_len) {
     uint8_t block[AES_BLK_LEN];
     uint32_t hdr = 0;
 
@@ -63,28 +72,16 @@ static void ccm_mac_aad(aes128_ctx *ctx, uint8_t y[AES_BLK_LEN], const uint8_t *
     }
 
     memset(block, 0, AES_BLK_LEN);
-    if (aad_len < 0xFF00) {
-        block[0] = (uint8_t)(aad_len >> 8);
-        block[1] = (uint8_t)(aad_len);
-        hdr = 2;
-    } else {
-        block[0] = 0xFF;
-        block[1] = 0xFE;
-        block[2] = (uint8_t)(aad_len >> 24);
-        block[3] = (uint8_t)(aad_len >> 16);
-        block[4] = (uint8_t)(aad_len >> 8);
-        block[5] = (uint8_t)(aad_len);
-        hdr = 6;
-    }
+    hdr = ccm_aad_hdr(block, aad_len);
 
     uint32_t copy = AES_BLK_LEN - hdr;
     if (copy > aad_len) copy = aad_len;
     memcpy(block + hdr, aad, copy);
-    ccm_mac_block(ctx, y, block);
+    ccm_mac_block(key, y, block);
     aad += copy;
     aad_len -= copy;
 
-    ccm_mac_data(ctx, y, aad, aad_len);
+    ccm_mac_data(key, y, aad, aad_len);
 }
 
 static void ccm_set_len(uint8_t *dst, uint32_t len, uint32_t L) {
@@ -94,48 +91,77 @@ static void ccm_set_len(uint8_t *dst, uint32_t len, uint32_t L) {
     }
 }
 
-static int ccm_ctr_inc(uint8_t ctr[AES_BLK_LEN], uint32_t L) {
+static void ccm_ctr_inc(uint8_t ctr[AES_BLK_LEN], uint32_t L) {
     for (int i = AES_BLK_LEN - 1; i >= (int)(AES_BLK_LEN - L); i--) {
         ctr[i]++;
         if (ctr[i] != 0) {
-            return 1;
+            return;
         }
     }
-    return 0;
 }
 
-static int ccm_ctr_crypt(aes128_ctx *ctx, const uint8_t *nonce, uint32_t nonce_len, uint32_t L,
-                         const uint8_t *in, uint8_t *out, uint32_t len) {
-    uint8_t ctr[AES_BLK_LEN];
-    uint8_t stream[AES_BLK_LEN];
-    memset(ctr, 0, AES_BLK_LEN);
-    ctr[0] = (uint8_t)(L - 1);
-    memcpy(ctr + 1, nonce, nonce_len);
-    ccm_set_len(ctr + AES_BLK_LEN - L, 1, L);
+/* Encrypt (enc) or decrypt len bytes and run the CBC-MAC y over the
+ * plaintext in the same loop. The MAC chain allows one block at a time,
+ * but the keystream block for the same position does not depend on it,
+ * so every AES call carries one of each and keeps two blocks in flight.
+ * ctr holds A0 on entry and s0 = E(K, A0) is returned in it; the
+ * decryption keystream runs one block ahead and rides along with A0.
+ */
+static void ccm_crypt_mac(const aes128_key *key, uint8_t ctr[AES_BLK_LEN], uint32_t L, uint8_t y[AES_BLK_LEN],
+                          const uint8_t *in, uint8_t *out, uint32_t len, int enc) {
+    uint8_t buf[2 * AES_BLK_LEN], p[AES_BLK_LEN], a[AES_BLK_LEN];
+
+    memcpy(a, ctr, AES_BLK_LEN);
+    memcpy(buf, a, AES_BLK_LEN);
+    ccm_ctr_inc(a, L);
+    if (enc || len == 0) {
+        aes128_key_encrypt(key, buf);
+    } else {
+        memcpy(buf + AES_BLK_LEN, a, AES_BLK_LEN);
+        ccm_ctr_inc(a, L);
+        aes128_key_encrypt_blocks(key, buf, buf, 2);
+    }
+    memcpy(ctr, buf, AES_BLK_LEN);
 
     while (len) {
-        memcpy(stream, ctr, AES_BLK_LEN);
-        aes128_ecb_encrypt(ctx, stream);
-
         uint32_t n = len > AES_BLK_LEN ? AES_BLK_LEN : len;
-        for (uint32_t i = 0; i < n; i++) {
-            out[i] = (uint8_t)(in[i] ^ stream[i]);
+        uint32_t nb = 2;
+
+        memset(p, 0, AES_BLK_LEN);
+        if (enc) {
+            memcpy(p, in, n);
+            memcpy(buf + AES_BLK_LEN, a, AES_BLK_LEN);
+        } else {
+            /* buf[1] holds this block's keystream from the last call */
+            for (uint32_t i = 0; i < n; i++) {
+                p[i] = in[i] ^ buf[AES_BLK_LEN + i];
+            }
+            memcpy(out, p, n);
+            if (len > AES_BLK_LEN) {
+                memcpy(buf + AES_BLK_LEN, a, AES_BLK_LEN);
+            } else {
+                nb = 1;
+            }
         }
-
-        if (!ccm_ctr_inc(ctr, L)) {
-            return 0;
+        ccm_ctr_inc(a, L);
+        for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
+            buf[i] = y[i] ^ p[i];
+        }
+        aes128_key_encrypt_blocks(key, buf, buf, nb);
+        memcpy(y, buf, AES_BLK_LEN);
+        if (enc) {
+            for (uint32_t i = 0; i < n; i++) {
+                out[i] = p[i] ^ buf[AES_BLK_LEN + i];
+            }
         }
 
         in  += n;
         out += n;
         len -= n;
     }
-    return 1;
 }
 
-static int ccm_params_ok(uint32_t key_len, uint32_t nonce_len, uint32_t tag_len,
-                         uint32_t aad_len, uint32_t msg_len) {
-    if (key_len != AES_KEY_LEN) return 0;
+static int ccm_params_ok(uint32_t nonce_len, uint32_t tag_len, uint32_t aad_len, uint32_t msg_len) {
     if (nonce_len < 7 || nonce_len > 13) return 0;
     if (tag_len < 4 || tag_len > 16 || (tag_len & 1)) return 0;
     (void)aad_len;
@@ -179,90 +205,294 @@ static int ct_eq_tag(const uint8_t *a, const uint8_t *b, uint32_t len) {
     return 1 ^ (int)d;
 }
 
-int aes128_ccm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                       const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
-                       uint8_t *crypt, uint8_t *tag, uint32_t tag_len) {
-    if (!ccm_params_ok(key_len, nonce_len, tag_len, aad_len, plain_len)) {
-        return -1;
-    }
-
-    aes128_ctx ctx;
+/* MAC B0 and the AAD, then encrypt or decrypt in one fused pass.
+   Leaves the untruncated tag T ^ s0 in tag. */
+static void ccm_run(const aes128_ccm_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                    const uint8_t *aad, uint32_t aad_len, const uint8_t *in, uint8_t *out, uint32_t len,
+                    uint32_t tag_len, int enc, uint8_t tag[AES_BLK_LEN]) {
     uint8_t y[AES_BLK_LEN] = {0};
     uint8_t b0[AES_BLK_LEN];
-    uint8_t a0[AES_BLK_LEN];
     uint8_t s0[AES_BLK_LEN];
-    uint8_t T[AES_BLK_LEN];
 
-    aes128_init_ctx(&ctx);
-    aes128_set_key(&ctx, key);
+    ccm_build_b0(b0, nonce_len, tag_len, nonce, len, aad_len != 0);
+    ccm_mac_block(&c->key, y, b0);
+    ccm_mac_aad(&c->key, y, aad, aad_len);
+
+    ccm_build_a0(s0, nonce, nonce_len);
+    ccm_crypt_mac(&c->key, s0, 15 - nonce_len, y, in, out, len, enc);
 
-    ccm_build_b0(b0, nonce_len, tag_len, nonce, plain_len, aad_len != 0);
-    ccm_mac_block(&ctx, y, b0);
-    ccm_mac_aad(&ctx, y, aad, aad_len);
-    ccm_mac_data(&ctx, y, plain, plain_len);
-    memcpy(T, y, AES_BLK_LEN);
+    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
+        tag[i] = (uint8_t)(y[i] ^ s0[i]);
+    }
+}
 
-    ccm_build_a0(a0, nonce, nonce_len);
-    memcpy(s0, a0, AES_BLK_LEN);
-    aes128_ecb_encrypt(&ctx, s0);
+/* Set up a CCM context by expanding the key.
+ * Returns 0 on success, -1 if key_len is not 16.
+ */
+int aes128_ccm_init(aes128_ccm_ctx *c, const uint8_t *key, uint32_t key_len) {
+    if (key_len != AES_KEY_LEN) {
+        return -1;
+    }
+    aes128_key_expand(&c->key, key);
+    return 0;
+}
 
-    if (plain_len) {
-        if (!ccm_ctr_crypt(&ctx, nonce, nonce_len, 15 - nonce_len, plain, crypt, plain_len)) {
-            return -1;
-        }
+/* CCM encryption under a context set up by aes128_ccm_init().
+ * Arguments and result are those of aes128_ccm_encrypt() without the key.
+ */
+int aes128_ccm_encrypt_ctx(const aes128_ccm_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                           uint8_t *crypt, uint8_t *tag, uint32_t tag_len) {
+    uint8_t T[AES_BLK_LEN];
+
+    if (!ccm_params_ok(nonce_len, tag_len, aad_len, plain_len)) {
+        return -1;
     }
+    ccm_run(c, nonce, nonce_len, aad, aad_len, plain, crypt, plain_len, tag_len, 1, T);
+    memcpy(tag, T, tag_len);
+    return 0;
+}
 
-    for (uint32_t i = 0; i < tag_len; i++) {
-        tag[i] = (uint8_t)(T[i] ^ s0[i]);
+/* CCM decryption under a context set up by aes128_ccm_init().
+ * Arguments and result are those of aes128_ccm_decrypt() without the
+ * key. On failure the plaintext buffer is zeroed.
+ */
+int aes128_ccm_decrypt_ctx(const aes128_ccm_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                           const uint8_t *tag, uint32_t tag_len, uint8_t *plain) {
+    uint8_t T[AES_BLK_LEN];
+
+    if (!ccm_params_ok(nonce_len, tag_len, aad_len, crypt_len)) {
+        return -1;
+    }
+    ccm_run(c, nonce, nonce_len, aad, aad_len, crypt, plain, crypt_len, tag_len, 0, T);
+
+    if (!ct_eq_tag(tag, T, tag_len)) {
+        if (crypt_len) {
+            memset(plain, 0, crypt_len);
+        }
+        return -1;
     }
 
     return 0;
 }
 
+int aes128_ccm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
+                       const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                       uint8_t *crypt, uint8_t *tag, uint32_t tag_len) {
+    aes128_ccm_ctx c;
+
+    if (aes128_ccm_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_ccm_encrypt_ctx(&c, nonce, nonce_len, aad, aad_len, plain, plain_len, crypt, tag, tag_len);
+}
+
 int aes128_ccm_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
                        const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
                        const uint8_t *tag, uint32_t tag_len, uint8_t *plain) {
-    if (!ccm_params_ok(key_len, nonce_len, tag_len, aad_len, crypt_len)) {
+    aes128_ccm_ctx c;
+
+    if (aes128_ccm_init(&c, key, key_len)) {
         return -1;
     }
+    return aes128_ccm_decrypt_ctx(&c, nonce, nonce_len, aad, aad_len, crypt, crypt_len, tag, tag_len, plain);
+}
 
-    aes128_ctx ctx;
-    uint8_t y[AES_BLK_LEN] = {0};
-    uint8_t b0[AES_BLK_LEN];
-    uint8_t a0[AES_BLK_LEN];
-    uint8_t s0[AES_BLK_LEN];
-    uint8_t T[AES_BLK_LEN];
-    uint8_t tag_calc[AES_BLK_LEN];
-
-    aes128_init_ctx(&ctx);
-    aes128_set_key(&ctx, key);
+/* --- Batched CCM --- */
+
+/* Messages advanced in lock-step; each contributes a CBC-MAC block and
+   a keystream block per AES call. */
+#define CCM_BATCH_LANES (AES_PAR_BLOCKS / 2)
+
+/* One message in progress. A message of m payload blocks and naad
+   formatted AAD blocks takes 1 + naad + m steps: step 0 MACs B0, steps
+   1 .. naad the AAD and the rest the payload. Encryption draws A_j's
+   keystream in the step that MACs P_j (and A0 in step 0), so in-place
+   output never overwrites unMACed plaintext. Decryption draws A_j in
+   step j - 1 (and A0 in step m), one or more steps before P_j is MACed. */
+typedef struct {
+    aes128_ccm_msg *m;
+    uint8_t y[AES_BLK_LEN];     /* CBC-MAC chain. */
+    uint8_t a[AES_BLK_LEN];     /* Next counter block A_j. */
+    uint8_t s0[AES_BLK_LEN];    /* E(K, A0). */
+    uint8_t x[AES_BLK_LEN];     /* This step's MAC input block. */
+    uint8_t hdr[6];             /* AAD length encoding. */
+    uint32_t hdr_len;
+    uint32_t L;
+    uint32_t naad;              /* Formatted AAD blocks. */
+    uint32_t nblk;              /* Payload blocks. */
+    uint32_t step;
+    int64_t ctr;                /* Counter block drawn this step: j, 0 for A0, or -1. */
+} ccm_lane;
+
+static void ccm_lane_start(ccm_lane *l, aes128_ccm_msg *m) {
+    l->m = m;
+    l->L = 15 - m->nonce_len;
+    l->hdr_len = m->aad_len ? ccm_aad_hdr(l->hdr, m->aad_len) : 0;
+    l->naad = (l->hdr_len + m->aad_len + AES_BLK_LEN - 1) / AES_BLK_LEN;
+    l->nblk = (m->len + AES_BLK_LEN - 1) / AES_BLK_LEN;
+    l->step = 0;
+    memset(l->y, 0, AES_BLK_LEN);
+    ccm_build_a0(l->a, m->nonce, m->nonce_len);
+    ccm_ctr_inc(l->a, l->L);
+}
 
-    ccm_build_a0(a0, nonce, nonce_len);
-    memcpy(s0, a0, AES_BLK_LEN);
-    aes128_ecb_encrypt(&ctx, s0);
+/* Bytes [off, off + 16) of p, which holds len bytes, zero-padded. */
+static void ccm_load(uint8_t block[AES_BLK_LEN], const uint8_t *p, size_t off, size_t len) {
+    if (len - off >= AES_BLK_LEN) {
+        memcpy(block, p + off, AES_BLK_LEN);
+    } else {
+        memset(block, 0, AES_BLK_LEN);
+        memcpy(block, p + off, len - off);
+    }
+}
 
-    if (crypt_len) {
-        if (!ccm_ctr_crypt(&ctx, nonce, nonce_len, 15 - nonce_len, crypt, plain, crypt_len)) {
-            return -1;
+/* Set up the lane's MAC input x for this step and pick its counter. */
+static void ccm_lane_input(ccm_lane *l, int enc) {
+    const aes128_ccm_msg *m = l->m;
+
+    if (l->step == 0) {
+        ccm_build_b0(l->x, m->nonce_len, m->tag_len, m->nonce, m->len, m->aad_len != 0);
+    } else if (l->step <= l->naad) {
+        if (l->step == 1) {
+            /* hdr || AAD; the header is at most 6 bytes */
+            uint32_t n = m->aad_len < AES_BLK_LEN - l->hdr_len ? m->aad_len : AES_BLK_LEN - l->hdr_len;
+            memset(l->x, 0, AES_BLK_LEN);
+            memcpy(l->x, l->hdr, l->hdr_len);
+            memcpy(l->x + l->hdr_len, m->aad, n);
+        } else {
+            ccm_load(l->x, m->aad, (size_t)(l->step - 1) * AES_BLK_LEN - l->hdr_len, m->aad_len);
         }
+    } else {
+        ccm_load(l->x, enc ? m->in : m->out, (size_t)(l->step - l->naad - 1) * AES_BLK_LEN, m->len);
     }
 
-    ccm_build_b0(b0, nonce_len, tag_len, nonce, crypt_len, aad_len != 0);
-    ccm_mac_block(&ctx, y, b0);
-    ccm_mac_aad(&ctx, y, aad, aad_len);
-    ccm_mac_data(&ctx, y, plain, crypt_len);
-    memcpy(T, y, AES_BLK_LEN);
+    if (enc) {
+        l->ctr = l->step == 0 ? 0 : l->step > l->naad ? (int64_t)(l->step - l->naad) : -1;
+    } else {
+        l->ctr = l->step < l->nblk ? (int64_t)l->step + 1 : l->step == l->nblk ? 0 : -1;
+    }
+}
 
-    for (uint32_t i = 0; i < tag_len; i++) {
-        tag_calc[i] = (uint8_t)(T[i] ^ s0[i]);
+/* Apply the keystream block ks for counter j of the lane. */
+static void ccm_lane_output(const ccm_lane *l, const uint8_t *ks, int enc) {
+    const aes128_ccm_msg *m = l->m;
+    size_t off = (size_t)(l->ctr - 1) * AES_BLK_LEN;
+    /* Encryption MACs P_j in this same step, so it is still in x */
+    const uint8_t *src = enc ? l->x : m->in + off;
+
+    if (m->len - off >= AES_BLK_LEN) {
+        xor16(m->out + off, src, ks);
+    } else {
+        for (size_t j = 0; j < m->len - off; j++) {
+            m->out[off + j] = src[j] ^ ks[j];
+        }
     }
+}
 
-    if (!ct_eq_tag(tag, tag_calc, tag_len)) {
-        if (crypt_len) {
-            memset(plain, 0, crypt_len);
+/* Finish a lane's message: tag it, or check its tag. */
+static int ccm_lane_finish(ccm_lane *l, int enc) {
+    aes128_ccm_msg *m = l->m;
+    uint8_t T[AES_BLK_LEN];
+
+    xor16(T, l->y, l->s0);
+    if (enc) {
+        memcpy(m->tag, T, m->tag_len);
+        return 0;
+    }
+    if (!ct_eq_tag(m->tag, T, m->tag_len)) {
+        if (m->len) {
+            memset(m->out, 0, m->len);
         }
         return -1;
     }
-
     return 0;
 }
+
+static int ccm_batch(const aes128_ccm_ctx *c, aes128_ccm_msg *msgs, size_t n, int enc) {
+    ccm_lane lane[CCM_BATCH_LANES];
+    uint8_t buf[2 * CCM_BATCH_LANES * AES_BLK_LEN];
+    uint32_t active = 0, nb;
+    size_t next = 0;
+    int rc = 0;
+
+    for (;;) {
+        /* Refill idle lanes with the next valid messages */
+        while (active < CCM_BATCH_LANES && next < n) {
+            aes128_ccm_msg *m = &msgs[next++];
+            if (!ccm_params_ok(m->nonce_len, m->tag_len, m->aad_len, m->len)) {
+                m->status = -1;
+                rc = -1;
+                continue;
+            }
+            ccm_lane_start(&lane[active++], m);
+        }
+        if (active == 0) {
+            break;
+        }
+
+        /* Gather one MAC block and at most one counter block per lane */
+        nb = 0;
+        for (uint32_t i = 0; i < active; i++) {
+            ccm_lane *l = &lane[i];
+
+            ccm_lane_input(l, enc);
+            xor16(buf + nb++ * AES_BLK_LEN, l->y, l->x);
+            if (l->ctr == 0) {
+                ccm_build_a0(buf + nb++ * AES_BLK_LEN, l->m->nonce, l->m->nonce_len);
+            } else if (l->ctr > 0) {
+                memcpy(buf + nb++ * AES_BLK_LEN, l->a, AES_BLK_LEN);
+                ccm_ctr_inc(l->a, l->L);
+            }
+        }
+
+        aes128_key_encrypt_blocks(&c->key, buf, buf, nb);
+
+        /* Scatter: advance each chain and apply each keystream block */
+        nb = 0;
+        for (uint32_t i = 0; i < active; i++) {
+            ccm_lane *l = &lane[i];
+
+            memcpy(l->y, buf + nb++ * AES_BLK_LEN, AES_BLK_LEN);
+            if (l->ctr == 0) {
+                memcpy(l->s0, buf + nb++ * AES_BLK_LEN, AES_BLK_LEN);
+            } else if (l->ctr > 0) {
+                ccm_lane_output(l, buf + nb++ * AES_BLK_LEN, enc);
+            }
+        }
+
+        /* Retire finished lanes, keeping the rest packed */
+        for (uint32_t i = 0; i < active; ) {
+            ccm_lane *l = &lane[i];
+            if (++l->step < 1 + l->naad + l->nblk) {
+                i++;
+                continue;
+            }
+            l->m->status = ccm_lane_finish(l, enc);
+            rc |= l->m->status;
+            lane[i] = lane[--active];
+        }
+    }
+    return rc;
+}
+
+/* Encrypt n independent messages under one keyed context, advancing up
+ * to CCM_BATCH_LANES CBC-MAC chains and their counters in lock-step so
+ * that each AES call carries several independent blocks. Each
+ * descriptor's status is set, and its tag written, exactly as
+ * aes128_ccm_encrypt_ctx() would.
+ * Returns 0 if every message succeeded, -1 otherwise.
+ */
+int aes128_ccm_encrypt_batch(const aes128_ccm_ctx *c, aes128_ccm_msg *msgs, size_t n) {
+    return ccm_batch(c, msgs, n, 1);
+}
+
+/* Decrypt and verify n independent messages under one keyed context.
+ * A message that fails authentication gets status -1 and a zeroed
+ * output buffer; the others are unaffected.
+ * Returns 0 if every message is authentic, -1 otherwise.
+ */
+int aes128_ccm_decrypt_batch(const aes128_ccm_ctx *c, aes128_ccm_msg *msgs, size_t n) {
+    return ccm_batch(c, msgs, n, 0);
+}
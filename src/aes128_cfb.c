@@ -27,17 +27,11 @@
 
 #include <aes128_cfb.h>
 
-/**
- * Encrypts data in-place using AES-128 in CFB mode (CFB-128).
- *
- * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
- * @param data  Pointer to the data buffer (plaintext) to encrypt.
- * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
- */
-int aes128_cfb_encrypt(aes128_ctx* c, void* data, uint32_t len) {
+/* CFB-128 encryption with key k, feeding back through the 16-byte fb */
+static int cfb_encrypt(const aes128_key* k, uint8_t* fb, void* data, uint32_t len) {
     uint8_t keystream[AES_BLK_LEN];
     uint8_t *buf = (uint8_t*)data;
-    uint8_t *iv  = c->iv;
+    uint8_t *iv  = fb;
 
     if (len == 0) {
         return 1;
@@ -48,7 +42,7 @@ int aes128_cfb_encrypt(aes128_ctx* c, void* data, uint32_t len) {
 
     while (len >= AES_BLK_LEN) {
         memcpy(keystream, iv, AES_BLK_LEN);
-        aes128_ecb_encrypt(c, keystream);
+        aes128_key_encrypt(k, keystream);
 
         for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
             buf[i] ^= keystream[i];
@@ -59,22 +53,16 @@ int aes128_cfb_encrypt(aes128_ctx* c, void* data, uint32_t len) {
         len -= AES_BLK_LEN;
     }
 
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) c->iv[i] = iv[i];
+    for (uint32_t i = 0; i < AES_BLK_LEN; i++) fb[i] = iv[i];
     return 1;
 }
 
-/**
- * Decrypts data in-place using AES-128 in CFB mode (CFB-128).
- *
- * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
- * @param data  Pointer to the data buffer (ciphertext) to decrypt.
- * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
- */
-int aes128_cfb_decrypt(aes128_ctx* c, void* data, uint32_t len) {
+/* CFB-128 decryption with key k, feeding back through the 16-byte fb */
+static int cfb_decrypt(const aes128_key* k, uint8_t* fb, void* data, uint32_t len) {
     uint8_t keystream[AES_BLK_LEN];
     uint8_t tmp[AES_BLK_LEN];
     uint8_t *buf = (uint8_t*)data;
-    uint8_t *iv  = c->iv;
+    uint8_t *iv  = fb;
 
     if (len == 0) {
         return 1;
@@ -85,7 +73,7 @@ int aes128_cfb_decrypt(aes128_ctx* c, void* data, uint32_t len) {
 
     while (len >= AES_BLK_LEN) {
         memcpy(keystream, iv, AES_BLK_LEN);
-        aes128_ecb_encrypt(c, keystream);
+        aes128_key_encrypt(k, keystream);
         memcpy(tmp, buf, AES_BLK_LEN);
 
         for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
@@ -97,6 +85,42 @@ int aes128_cfb_decrypt(aes128_ctx* c, void* data, uint32_t len) {
         len -= AES_BLK_LEN;
     }
 
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) c->iv[i] = iv[i];
+    for (uint32_t i = 0; i < AES_BLK_LEN; i++) fb[i] = iv[i];
     return 1;
 }
+
+/**
+ * Encrypts data in-place using AES-128 in CFB mode (CFB-128).
+ *
+ * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
+ * @param data  Pointer to the data buffer (plaintext) to encrypt.
+ * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
+ */
+int aes128_cfb_encrypt(aes128_ctx* c, void* data, uint32_t len) {
+    return cfb_encrypt(&c->key, c->iv, data, len);
+}
+
+/**
+ * Decrypts data in-place using AES-128 in CFB mode (CFB-128).
+ *
+ * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
+ * @param data  Pointer to the data buffer (ciphertext) to decrypt.
+ * @param len   Length in bytes of the data buffer (must be a multiple of AES_BLK_LEN).
+ */
+int aes128_cfb_decrypt(aes128_ctx* c, void* data, uint32_t len) {
+    return cfb_decrypt(&c->key, c->iv, data, len);
+}
+
+/**
+ * CFB-128 encryption on a stream that references a shared key.
+ */
+int aes128_cfb_encrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return cfb_encrypt(s->key, s->iv, data, len);
+}
+
+/**
+ * CFB-128 decryption on a stream that references a shared key.
+ */
+int aes128_cfb_decrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return cfb_decrypt(s->key, s->iv, data, len);
+}
@@ -0,0 +1,225 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+
+/*
+ * PCLMULQDQ engine for GHASH and POLYVAL (see aes128_ghash.c for the
+ * field representation). Up to AES_GF_POWERS blocks are multiplied by
+ * H^n .. H^1 with Karatsuba, the unreduced products are summed, and a
+ * single reduction folds the lot.
+ *
+ * Also home to the stitched AES-NI + PCLMULQDQ GCM kernels, which need
+ * both instruction sets.
+ */
+
+/* Two-step Montgomery reduction of hi:lo by x^128 + x^127 + x^126 + x^121 + 1 */
+static inline __m128i clmul_reduce(__m128i lo, __m128i hi) {
+    const __m128i poly = _mm_set_epi64x((long long)0xc200000000000000ULL, 1);
+    __m128i t;
+
+    t = _mm_clmulepi64_si128(lo, poly, 0x10);
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), t);
+    t = _mm_clmulepi64_si128(lo, poly, 0x10);
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), t);
+    return _mm_xor_si128(lo, hi);
+}
+
+/* Add the unreduced Karatsuba product b * h into lo, hi and mid. */
+static inline void clmul_acc(__m128i b, __m128i h, __m128i *lo, __m128i *hi, __m128i *mid) {
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(b, h, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(b, h, 0x11));
+    b = _mm_xor_si128(b, _mm_shuffle_epi32(b, 0x4e));
+    h = _mm_xor_si128(h, _mm_shuffle_epi32(h, 0x4e));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(b, h, 0x00));
+}
+
+/* Recombine the Karatsuba terms and reduce. */
+static inline __m128i clmul_fold(__m128i lo, __m128i hi, __m128i mid) {
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return clmul_reduce(lo, hi);
+}
+
+/**
+ * y = (y ^ X1) * H ... over n blocks; be byte-reverses each block for GHASH.
+ */
+void aes_clmul_update(const aes128_gf_key *k, uint64_t y[2], const uint8_t *x, size_t n, int be) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i acc = _mm_loadu_si128((const __m128i*)y);
+
+    while (n) {
+        size_t m = n < AES_GF_POWERS ? n : AES_GF_POWERS;
+        __m128i lo = _mm_setzero_si128(), hi = lo, mid = lo;
+
+        for (size_t i = 0; i < m; i++) {
+            __m128i b = _mm_loadu_si128((const __m128i*)(x + i * AES_BLK_LEN));
+            __m128i h = _mm_loadu_si128((const __m128i*)k->h[m - 1 - i]);
+            if (be) {
+                b = _mm_shuffle_epi8(b, bswap);
+            }
+            if (i == 0) {
+                b = _mm_xor_si128(b, acc);
+            }
+            clmul_acc(b, h, &lo, &hi, &mid);
+        }
+        acc = clmul_fold(lo, hi, mid);
+
+        x += m * AES_BLK_LEN;
+        n -= m;
+    }
+
+    _mm_storeu_si128((__m128i*)y, acc);
+}
+
+/* --- Stitched GCM --- */
+
+#define RK(i) _mm_loadu_si128((const __m128i*)&rk[i])
+
+/* Eight counter blocks from the big-endian 32-bit counter ctr (in
+   byte-reversed form, so the counter is the low dword), then advance it. */
+static inline void gcm_ctr8(__m128i x[8], __m128i *ctr, __m128i bswap, __m128i k0) {
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    __m128i c = *ctr;
+
+    for (int j = 0; j < 8; j++) {
+        x[j] = _mm_xor_si128(_mm_shuffle_epi8(c, bswap), k0);
+        c = _mm_add_epi32(c, one);
+    }
+    *ctr = c;
+}
+
+/**
+ * GCM encryption of n blocks (a multiple of eight) in one pass: the
+ * GHASH multiplies for each group of eight ciphertext blocks are issued
+ * between the AES rounds of the next group, so the two units work in
+ * parallel and every block is read and written once. ctr is the next
+ * counter block and y the GHASH accumulator, both in GCM byte order;
+ * both are updated.
+ */
+void aes_clmul_gcm_encrypt(const aes_key_t *rk, uint32_t nr, const aes128_gf_key *k,
+                           uint8_t *ctr, uint8_t *y, const uint8_t *in, uint8_t *out, size_t n) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)ctr), bswap);
+    __m128i acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)y), bswap);
+    __m128i x[8], p[8], lo, hi, mid, kr;
+    int have_prev = 0;
+
+    for (; n >= 8; n -= 8) {
+        gcm_ctr8(x, &c, bswap, RK(0));
+        lo = hi = mid = _mm_setzero_si128();
+
+        for (uint32_t r = 1; r < nr; r++) {
+            kr = RK(r);
+            for (int j = 0; j < 8; j++) {
+                x[j] = _mm_aesenc_si128(x[j], kr);
+            }
+            /* One block of the previous group's GHASH per round */
+            if (have_prev && r <= 8) {
+                clmul_acc(p[r - 1], _mm_loadu_si128((const __m128i*)k->h[8 - r]), &lo, &hi, &mid);
+            }
+        }
+        if (have_prev) {
+            acc = clmul_fold(lo, hi, mid);
+        }
+
+        kr = RK(nr);
+        for (int j = 0; j < 8; j++) {
+            x[j] = _mm_aesenclast_si128(x[j], kr);
+            x[j] = _mm_xor_si128(x[j], _mm_loadu_si128((const __m128i*)(in + 16 * j)));
+            _mm_storeu_si128((__m128i*)(out + 16 * j), x[j]);
+            p[j] = _mm_shuffle_epi8(x[j], bswap);
+        }
+        p[0] = _mm_xor_si128(p[0], acc);
+        have_prev = 1;
+        in  += 8 * AES_BLK_LEN;
+        out += 8 * AES_BLK_LEN;
+    }
+
+    /* Hash the last group */
+    if (have_prev) {
+        lo = hi = mid = _mm_setzero_si128();
+        for (int j = 0; j < 8; j++) {
+            clmul_acc(p[j], _mm_loadu_si128((const __m128i*)k->h[7 - j]), &lo, &hi, &mid);
+        }
+        acc = clmul_fold(lo, hi, mid);
+    }
+
+    _mm_storeu_si128((__m128i*)ctr, _mm_shuffle_epi8(c, bswap));
+    _mm_storeu_si128((__m128i*)y, _mm_shuffle_epi8(acc, bswap));
+}
+
+/**
+ * GCM decryption of n blocks (a multiple of eight) in one pass. The
+ * ciphertext is known up front, so each group is hashed while its own
+ * keystream is being generated. Arguments as for aes_clmul_gcm_encrypt().
+ */
+void aes_clmul_gcm_decrypt(const aes_key_t *rk, uint32_t nr, const aes128_gf_key *k,
+                           uint8_t *ctr, uint8_t *y, const uint8_t *in, uint8_t *out, size_t n) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)ctr), bswap);
+    __m128i acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)y), bswap);
+    __m128i x[8], p[8], lo, hi, mid, kr;
+
+    for (; n >= 8; n -= 8) {
+        for (int j = 0; j < 8; j++) {
+            p[j] = _mm_loadu_si128((const __m128i*)(in + 16 * j));
+        }
+        gcm_ctr8(x, &c, bswap, RK(0));
+        lo = hi = mid = _mm_setzero_si128();
+
+        for (uint32_t r = 1; r < nr; r++) {
+            kr = RK(r);
+            for (int j = 0; j < 8; j++) {
+                x[j] = _mm_aesenc_si128(x[j], kr);
+            }
+            if (r <= 8) {
+                __m128i b = _mm_shuffle_epi8(p[r - 1], bswap);
+                if (r == 1) {
+                    b = _mm_xor_si128(b, acc);
+                }
+                clmul_acc(b, _mm_loadu_si128((const __m128i*)k->h[8 - r]), &lo, &hi, &mid);
+            }
+        }
+        acc = clmul_fold(lo, hi, mid);
+
+        kr = RK(nr);
+        for (int j = 0; j < 8; j++) {
+            x[j] = _mm_aesenclast_si128(x[j], kr);
+            _mm_storeu_si128((__m128i*)(out + 16 * j), _mm_xor_si128(x[j], p[j]));
+        }
+        in  += 8 * AES_BLK_LEN;
+        out += 8 * AES_BLK_LEN;
+    }
+
+    _mm_storeu_si128((__m128i*)ctr, _mm_shuffle_epi8(c, bswap));
+    _mm_storeu_si128((__m128i*)y, _mm_shuffle_epi8(acc, bswap));
+}
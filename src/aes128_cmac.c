@@ -0,0 +1,349 @@
+/**
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+#include <aes128_cmac.h>
+#include <string.h>
+#include "aes128_impl.h"
+
+/* Messages in flight in the batch kernel, one block each per AES call */
+#define CMAC_BATCH_LANES AES_PAR_BLOCKS
+
+static void gf128_double(uint8_t *out, const uint8_t *in) {
+    uint8_t carry = 0;
+    for (int i = AES_BLK_LEN - 1; i >= 0; i--) {
+        uint8_t byte = in[i];
+        out[i] = (uint8_t)((byte << 1) | carry);
+        carry = (byte & 0x80) ? 1 : 0;
+    }
+    if (carry) {
+        out[AES_BLK_LEN - 1] ^= 0x87;
+    }
+}
+
+static int ct_eq(const uint8_t *a, const uint8_t *b, uint32_t n) {
+    uint32_t d = 0;
+    for (uint32_t i = 0; i < n; i++) d |= (uint32_t)(a[i] ^ b[i]);
+    d = (d | (uint32_t)(-(int32_t)d)) >> 31;
+    return 1 ^ (int)d;
+}
+
+/* Input to the last AES call: y ^ M_n ^ K1 for a full final block, or
+ * y ^ (M_n || 10..0) ^ K2 for a short one. x holds the n final bytes
+ * and is padded in place.
+ */
+static void cmac_last(const aes128_cmac_ctx *c, const uint8_t *y, uint8_t x[AES_BLK_LEN],
+                      uint32_t n, uint8_t *out) {
+    const uint8_t *k = c->k1;
+
+    if (n < AES_BLK_LEN) {
+        memset(x + n, 0, AES_BLK_LEN - n);
+        x[n] = 0x80;
+        k = c->k2;
+    }
+    xor16(out, y, x);
+    xor16(out, out, k);
+}
+
+/* Chain len more bytes into y. The final block takes a subkey, so the
+ * last 1..16 bytes seen so far always stay in buf until more input
+ * shows they were not the end.
+ */
+void aes_cmac_absorb(const aes128_key *k, uint8_t *y, uint8_t *buf, uint32_t *buf_len,
+                     const uint8_t *x, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (*buf_len < AES_BLK_LEN) {
+        size_t n = AES_BLK_LEN - *buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(buf + *buf_len, x, n);
+        *buf_len += (uint32_t)n;
+        x += n;
+        len -= n;
+        if (len == 0) {
+            return;
+        }
+    }
+
+    xor16(y, y, buf);
+    aes128_key_encrypt(k, y);
+    while (len > AES_BLK_LEN) {
+        xor16(y, y, x);
+        aes128_key_encrypt(k, y);
+        x += AES_BLK_LEN;
+        len -= AES_BLK_LEN;
+    }
+    memcpy(buf, x, len);
+    *buf_len = (uint32_t)len;
+}
+
+/* Write the 16-byte CMAC of everything absorbed into y and buf; the
+ * state itself is left as it was.
+ */
+void aes_cmac_finish(const aes128_cmac_ctx *c, const uint8_t *y, const uint8_t *buf, uint32_t buf_len,
+                     uint8_t *tag) {
+    uint8_t x[AES_BLK_LEN];
+
+    memcpy(x, buf, buf_len);
+    cmac_last(c, y, x, buf_len, tag);
+    aes128_key_encrypt(&c->key, tag);
+}
+
+/* Set up a CMAC context: expands the key and derives the subkeys
+ * K1 = 2L and K2 = 4L from L = E(K, 0).
+ * Returns 0 on success, -1 if key_len is not 16, 24 or 32.
+ */
+int aes128_cmac_init(aes128_cmac_ctx *c, const uint8_t *key, uint32_t key_len) {
+    uint8_t L[AES_BLK_LEN];
+
+    if (!aes128_key_expand_len(&c->key, key, key_len)) {
+        return -1;
+    }
+    memset(L, 0, AES_BLK_LEN);
+    aes128_key_encrypt(&c->key, L);
+    gf128_double(c->k1, L);
+    gf128_double(c->k2, c->k1);
+    return 0;
+}
+
+/* Begin a message under the context c, which must stay valid, and
+ * unchanged, while the stream is in use.
+ * Returns 0 on success.
+ */
+int aes128_cmac_stream_init(aes128_cmac_stream *s, const aes128_cmac_ctx *c) {
+    s->cmac = c;
+    memset(&s->st, 0, sizeof s->st);
+    return 0;
+}
+
+/* Add the next len bytes of the message; chunks may be any size.
+ * Returns 0 on success.
+ */
+int aes128_cmac_stream_update(aes128_cmac_stream *s, const uint8_t *in, size_t len) {
+    aes_cmac_absorb(&s->cmac->key, s->st.y, s->st.buf, &s->st.buf_len, in, len);
+    return 0;
+}
+
+/* Write the 16-byte tag of the input so far. The stream is not
+ * consumed: more input may follow, giving the tag of a longer message.
+ * Returns 0 on success.
+ */
+int aes128_cmac_stream_final(const aes128_cmac_stream *s, uint8_t *tag) {
+    aes_cmac_finish(s->cmac, s->st.y, s->st.buf, s->st.buf_len, tag);
+    return 0;
+}
+
+/* Check the first tag_len bytes of a tag against the input so far, in
+ * constant time.
+ * Returns 0 if the tag matches, -1 if not or if tag_len is not 1..16.
+ */
+int aes128_cmac_stream_verify(const aes128_cmac_stream *s, const uint8_t *tag, uint32_t tag_len) {
+    uint8_t T[AES_BLK_LEN];
+
+    if (tag_len == 0 || tag_len > AES_BLK_LEN) {
+        return -1;
+    }
+    aes128_cmac_stream_final(s, T);
+    return ct_eq(tag, T, tag_len) ? 0 : -1;
+}
+
+/* Copy out the chaining state, e.g. after a shared header. */
+void aes128_cmac_stream_save(const aes128_cmac_stream *s, aes128_cmac_state *st) {
+    *st = s->st;
+}
+
+/* Resume a stream under c from a state saved with the same key. */
+void aes128_cmac_stream_restore(aes128_cmac_stream *s, const aes128_cmac_ctx *c, const aes128_cmac_state *st) {
+    s->cmac = c;
+    s->st = *st;
+}
+
+/* Write the 16-byte CMAC of len bytes at in.
+ * Returns 0 on success.
+ */
+int aes128_cmac_sign(const aes128_cmac_ctx *c, const uint8_t *in, size_t len, uint8_t *tag) {
+    aes128_cmac_stream s;
+
+    aes128_cmac_stream_init(&s, c);
+    aes128_cmac_stream_update(&s, in, len);
+    return aes128_cmac_stream_final(&s, tag);
+}
+
+/* Check a tag of tag_len bytes (1..16) over len bytes at in.
+ * Returns 0 if the tag matches, -1 otherwise.
+ */
+int aes128_cmac_verify(const aes128_cmac_ctx *c, const uint8_t *in, size_t len,
+                       const uint8_t *tag, uint32_t tag_len) {
+    aes128_cmac_stream s;
+
+    aes128_cmac_stream_init(&s, c);
+    aes128_cmac_stream_update(&s, in, len);
+    return aes128_cmac_stream_verify(&s, tag, tag_len);
+}
+
+/* --- Batched CMAC --- */
+
+/* One message in flight: its chain, the saved prefix bytes not yet
+   chained, and the input still to come. */
+typedef struct {
+    aes128_cmac_msg *m;
+    uint8_t y[AES_BLK_LEN];
+    uint8_t head[AES_BLK_LEN];
+    uint32_t head_len;
+    const uint8_t *p;
+    size_t r;
+} cmac_lane;
+
+static void cmac_lane_start(cmac_lane *l, aes128_cmac_msg *m) {
+    l->m = m;
+    if (m->prefix) {
+        memcpy(l->y, m->prefix->y, AES_BLK_LEN);
+        memcpy(l->head, m->prefix->buf, AES_BLK_LEN);
+        l->head_len = m->prefix->buf_len;
+    } else {
+        memset(l->y, 0, AES_BLK_LEN);
+        l->head_len = 0;
+    }
+    l->p = m->in;
+    l->r = m->len;
+}
+
+/* Write the lane's next AES input; returns 1 if it is the last block. */
+static int cmac_lane_input(const aes128_cmac_ctx *c, cmac_lane *l, uint8_t *blk) {
+    uint8_t x[AES_BLK_LEN];
+    size_t avail = l->head_len + l->r;
+
+    if (avail > AES_BLK_LEN) {
+        size_t n = AES_BLK_LEN - l->head_len;
+
+        if (l->head_len) {
+            memcpy(x, l->head, l->head_len);
+            memcpy(x + l->head_len, l->p, n);
+            l->head_len = 0;
+            xor16(blk, l->y, x);
+        } else {
+            xor16(blk, l->y, l->p);
+        }
+        l->p += n;
+        l->r -= n;
+        return 0;
+    }
+
+    memcpy(x, l->head, l->head_len);
+    if (l->r) {
+        memcpy(x + l->head_len, l->p, l->r);
+    }
+    cmac_last(c, l->y, x, (uint32_t)avail, blk);
+    return 1;
+}
+
+/* Run up to CMAC_BATCH_LANES chains side by side: every AES call takes
+ * one block from each message in flight, and a finished message's lane
+ * is handed to the next one in the list.
+ */
+static int cmac_batch(const aes128_cmac_ctx *c, aes128_cmac_msg *m, size_t n, int sign) {
+    cmac_lane lane[CMAC_BATCH_LANES];
+    uint8_t blk[CMAC_BATCH_LANES * AES_BLK_LEN];
+    int last[CMAC_BATCH_LANES];
+    uint32_t active = 0;
+    size_t next = 0;
+    int rc = 0;
+
+    for (;;) {
+        while (active < CMAC_BATCH_LANES && next < n) {
+            aes128_cmac_msg *mm = &m[next++];
+
+            if (mm->tag_len == 0 || mm->tag_len > AES_BLK_LEN) {
+                mm->status = -1;
+                rc = -1;
+                continue;
+            }
+            cmac_lane_start(&lane[active++], mm);
+        }
+        if (active == 0) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < active; i++) {
+            last[i] = cmac_lane_input(c, &lane[i], blk + i * AES_BLK_LEN);
+        }
+        aes128_key_encrypt_blocks(&c->key, blk, blk, active);
+
+        /* Retire finished lanes from the top down so the moves below
+           only bring in lanes that were already handled */
+        for (uint32_t i = active; i-- > 0; ) {
+            const uint8_t *y = blk + i * AES_BLK_LEN;
+            aes128_cmac_msg *mm = lane[i].m;
+
+            if (!last[i]) {
+                memcpy(lane[i].y, y, AES_BLK_LEN);
+                continue;
+            }
+            if (sign) {
+                memcpy(mm->tag, y, mm->tag_len);
+                mm->status = 0;
+            } else {
+                mm->status = ct_eq(mm->tag, y, mm->tag_len) ? 0 : -1;
+                rc |= mm->status;
+            }
+            lane[i] = lane[--active];
+        }
+    }
+    return rc;
+}
+
+/* Sign n independent messages under one context, for traffic made of
+ * many short messages. Each descriptor gets tag_len bytes of its tag
+ * and a status; a bad tag_len fails that message alone.
+ * Returns 0 if every message succeeded, -1 otherwise.
+ */
+int aes128_cmac_sign_batch(const aes128_cmac_ctx *c, aes128_cmac_msg *msgs, size_t n) {
+    return cmac_batch(c, msgs, n, 1);
+}
+
+/* Verify n independent messages under one context. Each descriptor's
+ * status is 0 if its tag matches and -1 otherwise.
+ * Returns 0 if every tag matched, -1 otherwise.
+ */
+int aes128_cmac_verify_batch(const aes128_cmac_ctx *c, aes128_cmac_msg *msgs, size_t n) {
+    return cmac_batch(c, msgs, n, 0);
+}
+
+/* One-shot CMAC of len bytes at in under a raw key of 16, 24 or 32
+ * bytes, writing a 16-byte tag.
+ * Returns 0 on success, -1 on a bad key length.
+ */
+int aes128_cmac(const uint8_t *key, uint32_t key_len, const uint8_t *in, size_t len, uint8_t *tag) {
+    aes128_cmac_ctx c;
+
+    if (aes128_cmac_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_cmac_sign(&c, in, len, tag);
+}
@@ -0,0 +1,86 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static long aes_cpu_state = -1;
+
+/* Relaxed atomics on the cached answer: every thread that queries the
+   CPU stores the same value, so only the accesses need to be atomic. */
+static inline long cpu_state_load(void) {
+#if defined(_MSC_VER)
+    return _InterlockedOr((volatile long *)&aes_cpu_state, 0);
+#else
+    return __atomic_load_n(&aes_cpu_state, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void cpu_state_store(long v) {
+#if defined(_MSC_VER)
+    _InterlockedExchange((volatile long *)&aes_cpu_state, v);
+#else
+    __atomic_store_n(&aes_cpu_state, v, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * Returns the CPUID leaf 1 ECX feature word. The query is made once;
+ * concurrent first calls simply store the same answer.
+ */
+static uint32_t aes_cpu_features(void) {
+    long state = cpu_state_load();
+
+    if (state < 0) {
+        uint32_t ecx;
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuid(r, 1);
+        ecx = (uint32_t)r[2];
+#else
+        uint32_t eax, ebx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            ecx = 0;
+        }
+#endif
+        state = (long)(ecx & 0x7fffffff);
+        cpu_state_store(state);
+    }
+    return (uint32_t)state;
+}
+
+/**
+ * Returns 1 if the CPU reports all bits of feature (AES_CPU_*).
+ */
+int aes_cpu_has(uint32_t feature) {
+    return (aes_cpu_features() & feature) == feature;
+}
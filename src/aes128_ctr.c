@@ -26,6 +26,7 @@
  */
 
 #include <aes128_ctr.h>
+#include "aes128_impl.h"
 
 static int ctr32_inc_be(uint8_t ctr[16]) {
     for (int i = AES_BLK_LEN - 1; i >= 12; i--) {
@@ -53,21 +54,9 @@ void aes128_ctr_set(aes128_ctx* c, const void* nonce) {
     memcpy(c->ctr, nonce, 12);
 }
 
-/**
- * Encrypts (or decrypts) data using AES-128 in CTR mode.
- *
- * CTR mode turns a block cipher into a stream cipher by encrypting a counter
- * block and XORing the result with the plaintext. Note that encryption and
- * decryption are identical operations in CTR mode.
- *
- * @param c     Pointer to the AES-128 context containing the key schedule and counter.
- * @param data  Pointer to the data buffer (plaintext or ciphertext).
- * @param len   Length of the data in bytes.
- *
- * @return      1 on success, or 0 if the 4-byte counter overflows.
- */
-int aes128_ctr_encrypt(aes128_ctx* c, void* data, uint32_t len) {
-    uint8_t keystream[AES_BLK_LEN];
+/* CTR keystream with key k and the 16-byte counter block ctr */
+static int ctr_crypt(const aes128_key* k, uint8_t* ctr, void* data, uint32_t len) {
+    uint8_t keystream[AES_PAR_BLOCKS * AES_BLK_LEN];
     uint8_t *p = (uint8_t*)data;
 
     if (len == 0) {
@@ -76,42 +65,65 @@ int aes128_ctr_encrypt(aes128_ctx* c, void* data, uint32_t len) {
 
     uint64_t blocks = ((uint64_t)len + AES_BLK_LEN - 1) / AES_BLK_LEN;
     {
-        uint32_t ctr_val = ((uint32_t)c->ctr[12] << 24) |
-                           ((uint32_t)c->ctr[13] << 16) |
-                           ((uint32_t)c->ctr[14] << 8)  |
-                           ((uint32_t)c->ctr[15]);
+        uint32_t ctr_val = ((uint32_t)ctr[12] << 24) |
+                           ((uint32_t)ctr[13] << 16) |
+                           ((uint32_t)ctr[14] << 8)  |
+                           ((uint32_t)ctr[15]);
         if (blocks > 0x100000000ULL - (uint64_t)ctr_val) {
             return 0;
         }
     }
 
     while (len > 0) {
-        // Prepare the keystream block by copying the current 16-byte counter block.
-        memcpy(keystream, c->ctr, AES_BLK_LEN);
+        // Prepare a run of keystream blocks from consecutive counter values.
+        // Only the counter portion (last 4 bytes of ctr) is incremented;
+        // the nonce (first 12 bytes) remains unchanged.
+        uint32_t nblocks = (uint32_t)((blocks > AES_PAR_BLOCKS) ? AES_PAR_BLOCKS : blocks);
+        for (uint32_t i = 0; i < nblocks; i++) {
+            memcpy(keystream + (i * AES_BLK_LEN), ctr, AES_BLK_LEN);
+            ctr32_inc_be(ctr);
+        }
 
-        // Encrypt the counter block using AES-128 ECB mode to generate the keystream.
-        aes128_ecb_encrypt(c, keystream);
+        // Encrypt the counter blocks together to generate the keystream.
+        aes128_key_encrypt_blocks(k, keystream, keystream, nblocks);
 
-        // Determine the number of bytes to process in this block.
-        uint32_t block_bytes = (len > AES_BLK_LEN) ? AES_BLK_LEN : len;
+        // Determine the number of bytes to process in this run.
+        uint32_t run = nblocks * AES_BLK_LEN;
+        if (run > len) {
+            run = len;
+        }
 
         // XOR the keystream with the plaintext (or ciphertext).
-        for (uint32_t i = 0; i < block_bytes; i++) {
+        for (uint32_t i = 0; i < run; i++) {
             p[i] ^= keystream[i];
         }
 
         // Advance the data pointer and decrease the length.
-        len -= block_bytes;
-        p += block_bytes;
-
-        // Increment only the counter portion (last 4 bytes of c->ctr).
-        // The nonce (first 12 bytes) remains unchanged.
-        ctr32_inc_be(c->ctr);
+        len -= run;
+        p += run;
+        blocks -= nblocks;
     }
 
     return 1;
 }
 
+/**
+ * Encrypts (or decrypts) data using AES-128 in CTR mode.
+ *
+ * CTR mode turns a block cipher into a stream cipher by encrypting a counter
+ * block and XORing the result with the plaintext. Note that encryption and
+ * decryption are identical operations in CTR mode.
+ *
+ * @param c     Pointer to the AES-128 context containing the key schedule and counter.
+ * @param data  Pointer to the data buffer (plaintext or ciphertext).
+ * @param len   Length of the data in bytes.
+ *
+ * @return      1 on success, or 0 if the 4-byte counter overflows.
+ */
+int aes128_ctr_encrypt(aes128_ctx* c, void* data, uint32_t len) {
+    return ctr_crypt(&c->key, c->ctr, data, len);
+}
+
 /**
  * Decrypts data using AES-128 in CTR mode.
  *
@@ -127,3 +139,25 @@ int aes128_ctr_decrypt(aes128_ctx* c, void* data, uint32_t len) {
     return aes128_ctr_encrypt(c, data, len);
 }
 
+
+/**
+ * Sets the 12-byte nonce of a stream; the block counter starts at 0.
+ */
+void aes128_ctr_set_stream(aes128_stream* s, const void* nonce) {
+    memset(s->ctr, 0, AES_BLK_LEN);
+    memcpy(s->ctr, nonce, 12);
+}
+
+/**
+ * CTR encryption (or decryption) on a stream that references a shared key.
+ * Only s->ctr is updated.
+ *
+ * @return      1 on success, or 0 if the 4-byte counter overflows.
+ */
+int aes128_ctr_encrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return ctr_crypt(s->key, s->ctr, data, len);
+}
+
+int aes128_ctr_decrypt_stream(aes128_stream* s, void* data, uint32_t len) {
+    return ctr_crypt(s->key, s->ctr, data, len);
+}
@@ -26,205 +26,301 @@
  */
 
 #include <aes128_eax.h>
-
-static void xor_block(uint8_t *dst, const uint8_t *src) {
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        dst[i] ^= src[i];
+#include <string.h>
+#include "aes128_impl.h"
+
+/* OMAC^t_K (EAX, section 3) is CMAC over [t]_16 || data, run on the
+   shared CMAC core. The state after the tweak block, E(K, [t]), and
+   the whole OMAC of an empty string depend only on the key and come
+   from the context. */
+static void omac_final(uint8_t out[AES_BLK_LEN], const aes128_eax_ctx *c, uint8_t tweak,
+                       const uint8_t y[AES_BLK_LEN], const uint8_t buf[AES_BLK_LEN], uint32_t buf_len,
+                       uint64_t total) {
+    if (total == 0) {
+        memcpy(out, c->empty[tweak], AES_BLK_LEN);
+        return;
     }
+    aes_cmac_finish(&c->cmac, y, buf, buf_len, out);
+}
+
+static void omac_t(uint8_t out[AES_BLK_LEN], const aes128_eax_ctx *c, uint8_t tweak,
+                   const uint8_t *data, size_t len) {
+    uint8_t y[AES_BLK_LEN], buf[AES_BLK_LEN];
+    uint32_t buf_len = 0;
+
+    memcpy(y, c->tweak[tweak], AES_BLK_LEN);
+    aes_cmac_absorb(&c->cmac.key, y, buf, &buf_len, data, len);
+    omac_final(out, c, tweak, y, buf, buf_len, len);
 }
 
-static void gf128_double(uint8_t *out, const uint8_t *in) {
-    uint8_t carry = 0;
+static void ctr_inc_be(uint8_t ctr[AES_BLK_LEN]) {
     for (int i = AES_BLK_LEN - 1; i >= 0; i--) {
-        uint8_t byte = in[i];
-        out[i] = (uint8_t)((byte << 1) | carry);
-        carry = (byte & 0x80) ? 1 : 0;
-    }
-    if (carry) {
-        out[AES_BLK_LEN - 1] ^= 0x87;
+        ctr[i]++;
+        if (ctr[i] != 0) {
+            return;
+        }
     }
 }
 
-static void cmac_subkeys(aes128_ctx *ctx, uint8_t k1[AES_BLK_LEN], uint8_t k2[AES_BLK_LEN]) {
-    uint8_t L[AES_BLK_LEN] = {0};
-    aes128_ecb_encrypt(ctx, L);
-    gf128_double(k1, L);
-    gf128_double(k2, k1);
+static int ct_eq16(const uint8_t a[16], const uint8_t b[16]) {
+    uint32_t d = 0;
+    for (int i = 0; i < 16; i++) d |= (uint32_t)(a[i] ^ b[i]);
+    d = (d | (uint32_t)(-(int32_t)d)) >> 31;
+    return 1 ^ (int)d;
 }
 
-static void omac_t(uint8_t out[AES_BLK_LEN], aes128_ctx *ctx, const uint8_t k1[AES_BLK_LEN],
-                   const uint8_t k2[AES_BLK_LEN], uint8_t tweak, const uint8_t *data, uint32_t len) {
-    uint8_t y[AES_BLK_LEN] = {0};
-    uint8_t block[AES_BLK_LEN] = {0};
-
-    block[AES_BLK_LEN - 1] = tweak;
-
-    if (len == 0) {
-        xor_block(block, k1);
-        aes128_ecb_encrypt(ctx, block);
-        memcpy(out, block, AES_BLK_LEN);
-        return;
+/* Set up an EAX context: the CMAC context (key schedule and subkeys)
+ * plus, for each tweak t in 0..2, the chaining value E(K, [t]) and the
+ * OMAC of an empty string E(K, [t] ^ K1), three blocks per call.
+ * Returns 0 on success, -1 if key_len is not 16.
+ */
+int aes128_eax_init(aes128_eax_ctx *c, const uint8_t *key, uint32_t key_len) {
+    if (key_len != AES_KEY_LEN || aes128_cmac_init(&c->cmac, key, key_len)) {
+        return -1;
     }
 
-    xor_block(block, y);
-    aes128_ecb_encrypt(ctx, block);
-    memcpy(y, block, AES_BLK_LEN);
-
-    uint32_t full = len / AES_BLK_LEN;
-    uint32_t rem  = len % AES_BLK_LEN;
-    const uint8_t *p = data;
-
-    if (full > 1) {
-        for (uint32_t i = 0; i + 1 < full; i++) {
-            for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
-                block[j] = (uint8_t)(p[j] ^ y[j]);
-            }
-            aes128_ecb_encrypt(ctx, block);
-            memcpy(y, block, AES_BLK_LEN);
-            p += AES_BLK_LEN;
-        }
+    memset(c->tweak, 0, sizeof c->tweak);
+    for (uint8_t t = 0; t < 3; t++) {
+        c->tweak[t][AES_BLK_LEN - 1] = t;
+        memcpy(c->empty[t], c->cmac.k1, AES_BLK_LEN);
+        c->empty[t][AES_BLK_LEN - 1] ^= t;
     }
+    aes128_key_encrypt_blocks(&c->cmac.key, c->tweak, c->tweak, 3);
+    aes128_key_encrypt_blocks(&c->cmac.key, c->empty, c->empty, 3);
+    return 0;
+}
 
-    if (rem == 0) {
-        if (full > 0) {
-            for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
-                block[j] = (uint8_t)(p[j] ^ k1[j] ^ y[j]);
-            }
-            aes128_ecb_encrypt(ctx, block);
-            memcpy(out, block, AES_BLK_LEN);
-        }
-        return;
-    }
+/* EAX encryption under a context set up by aes128_eax_init().
+ * Arguments and result are those of aes128_eax_encrypt() without the key.
+ */
+int aes128_eax_encrypt_ctx(const aes128_eax_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                           uint8_t *crypt, uint8_t *tag) {
+    aes128_eax_stream s;
+
+    aes128_eax_stream_init(&s, c, nonce, nonce_len);
+    aes128_eax_stream_aad(&s, aad, aad_len);
+    aes128_eax_stream_encrypt(&s, plain, crypt, plain_len);
+    return aes128_eax_stream_final(&s, tag);
+}
 
-    if (full > 0) {
-        for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
-            block[j] = (uint8_t)(p[j] ^ y[j]);
+/* EAX decryption under a context set up by aes128_eax_init().
+ * Arguments and result are those of aes128_eax_decrypt() without the key.
+ */
+int aes128_eax_decrypt_ctx(const aes128_eax_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                           const uint8_t *tag, uint8_t *plain) {
+    aes128_eax_stream s;
+
+    aes128_eax_stream_init(&s, c, nonce, nonce_len);
+    aes128_eax_stream_aad(&s, aad, aad_len);
+    aes128_eax_stream_decrypt(&s, crypt, plain, crypt_len);
+    if (aes128_eax_stream_verify(&s, tag)) {
+        if (crypt_len) {
+            memset(plain, 0, crypt_len);
         }
-        aes128_ecb_encrypt(ctx, block);
-        memcpy(y, block, AES_BLK_LEN);
-        p += AES_BLK_LEN;
+        return -1;
     }
+    return 0;
+}
 
-    memset(block, 0, AES_BLK_LEN);
-    memcpy(block, p, rem);
-    block[rem] = 0x80;
-    for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
-        block[j] = (uint8_t)(block[j] ^ k2[j] ^ y[j]);
+int aes128_eax_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
+                       const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
+                       uint8_t *crypt, uint8_t *tag) {
+    aes128_eax_ctx c;
+
+    if (aes128_eax_init(&c, key, key_len)) {
+        return -1;
     }
-    aes128_ecb_encrypt(ctx, block);
-    memcpy(out, block, AES_BLK_LEN);
+    return aes128_eax_encrypt_ctx(&c, nonce, nonce_len, aad, aad_len, plain, plain_len, crypt, tag);
 }
 
-static int ctr_inc_be(uint8_t ctr[AES_BLK_LEN]) {
-    for (int i = AES_BLK_LEN - 1; i >= 0; i--) {
-        ctr[i]++;
-        if (ctr[i] != 0) {
-            return 1;
-        }
+int aes128_eax_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
+                       const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
+                       const uint8_t *tag, uint8_t *plain) {
+    aes128_eax_ctx c;
+
+    if (aes128_eax_init(&c, key, key_len)) {
+        return -1;
     }
-    return 0;
+    return aes128_eax_decrypt_ctx(&c, nonce, nonce_len, aad, aad_len, crypt, crypt_len, tag, plain);
 }
 
-static int eax_ctr_crypt(aes128_ctx *ctx, const uint8_t nonce[AES_BLK_LEN],
-                         const uint8_t *in, uint8_t *out, uint32_t len) {
-    uint8_t ctr[AES_BLK_LEN];
-    uint8_t stream[AES_BLK_LEN];
-    memcpy(ctr, nonce, AES_BLK_LEN);
+/* --- Streaming EAX --- */
 
-    while (len) {
-        memcpy(stream, ctr, AES_BLK_LEN);
-        aes128_ecb_encrypt(ctx, stream);
+/* Encrypt or decrypt len bytes and MAC the ciphertext in the same pass.
+ * Each step hands the engine two independent blocks: the ciphertext
+ * OMAC absorbing the block held back by the previous step, and the
+ * counter block for this step's keystream. The chain thus lags the
+ * keystream by one block, which is exactly the block OMAC has to hold
+ * back for the final K1/K2 mask anyway.
+ */
+static void eax_stream_crypt(aes128_eax_stream *s, const uint8_t *in, uint8_t *out, size_t len, int enc) {
+    uint32_t off = (uint32_t)s->len & (AES_BLK_LEN - 1);
+    uint8_t blk[2 * AES_BLK_LEN];
 
-        uint32_t n = len > AES_BLK_LEN ? AES_BLK_LEN : len;
-        for (uint32_t i = 0; i < n; i++) {
-            out[i] = (uint8_t)(in[i] ^ stream[i]);
-        }
+    s->len += len;
 
-        if (!ctr_inc_be(ctr)) {
-            return 0;
+    /* Rest of the keystream block left over from the last call */
+    if (off) {
+        size_t n = AES_BLK_LEN - off;
+        if (n > len) {
+            n = len;
         }
-        in  += n;
+        for (size_t i = 0; i < n; i++) {
+            uint8_t x = in[i], o = (uint8_t)(x ^ s->ks[off + i]);
+            out[i] = o;
+            s->buf[s->buf_len + i] = enc ? o : x;
+        }
+        s->buf_len += (uint32_t)n;
+        in += n;
         out += n;
         len -= n;
     }
-    return 1;
-}
-
-static int ct_eq16(const uint8_t a[16], const uint8_t b[16]) {
-    uint32_t d = 0;
-    for (int i = 0; i < 16; i++) d |= (uint32_t)(a[i] ^ b[i]);
-    d = (d | (uint32_t)(-(int32_t)d)) >> 31;
-    return 1 ^ (int)d;
-}
-
-int aes128_eax_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                       const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
-                       uint8_t *crypt, uint8_t *tag) {
-    if (key_len != AES_KEY_LEN) {
-        return -1;
-    }
 
-    aes128_ctx ctx;
-    uint8_t k1[AES_BLK_LEN], k2[AES_BLK_LEN];
-    uint8_t n[AES_BLK_LEN], h[AES_BLK_LEN], c[AES_BLK_LEN];
-
-    aes128_init_ctx(&ctx);
-    aes128_set_key(&ctx, key);
-    cmac_subkeys(&ctx, k1, k2);
+    while (len) {
+        size_t n = len > AES_BLK_LEN ? AES_BLK_LEN : len;
+        uint32_t nb = 0;
 
-    omac_t(n, &ctx, k1, k2, 0, nonce, nonce_len);
-    omac_t(h, &ctx, k1, k2, 1, aad, aad_len);
+        /* buf is full here unless this is the first data block */
+        if (s->buf_len == AES_BLK_LEN) {
+            xor16(blk, s->y, s->buf);
+            nb = 1;
+        }
+        memcpy(blk + nb * AES_BLK_LEN, s->ctr, AES_BLK_LEN);
+        ctr_inc_be(s->ctr);
+        aes128_key_encrypt_blocks(&s->eax->cmac.key, blk, blk, nb + 1);
+        if (nb) {
+            memcpy(s->y, blk, AES_BLK_LEN);
+        }
 
-    if (plain_len) {
-        if (!eax_ctr_crypt(&ctx, n, plain, crypt, plain_len)) {
-            return -1;
+        const uint8_t *ks = blk + nb * AES_BLK_LEN;
+        if (n == AES_BLK_LEN) {
+            if (!enc) {
+                memcpy(s->buf, in, AES_BLK_LEN);
+            }
+            xor16(out, in, ks);
+            if (enc) {
+                memcpy(s->buf, out, AES_BLK_LEN);
+            }
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                uint8_t x = in[i], o = (uint8_t)(x ^ ks[i]);
+                out[i] = o;
+                s->buf[i] = enc ? o : x;
+            }
+            memcpy(s->ks, ks, AES_BLK_LEN);
         }
+        s->buf_len = (uint32_t)n;
+
+        in += n;
+        out += n;
+        len -= n;
     }
+}
 
-    omac_t(c, &ctx, k1, k2, 2, crypt, plain_len);
+/* Finish the header OMAC and switch the chain over to the ciphertext. */
+static void eax_stream_data(aes128_eax_stream *s) {
+    uint8_t h[AES_BLK_LEN];
 
+    omac_final(h, s->eax, 1, s->y, s->buf, s->buf_len, s->aad_len);
     for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        tag[i] = (uint8_t)(n[i] ^ h[i] ^ c[i]);
+        s->mask[i] ^= h[i];
     }
+    memcpy(s->y, s->eax->tweak[2], AES_BLK_LEN);
+    s->buf_len = 0;
+    s->state = AES128_EAX_STREAM_DATA;
+}
 
+/* Begin a message under the keyed context c and the given nonce, which
+ * may be any length. c must stay valid, and unchanged, until the stream
+ * is finished.
+ * Returns 0 on success.
+ */
+int aes128_eax_stream_init(aes128_eax_stream *s, const aes128_eax_ctx *c,
+                           const uint8_t *nonce, uint32_t nonce_len) {
+    s->eax = c;
+    omac_t(s->mask, c, 0, nonce, nonce_len);
+    memcpy(s->ctr, s->mask, AES_BLK_LEN);
+    memcpy(s->y, c->tweak[1], AES_BLK_LEN);
+    s->aad_len = 0;
+    s->len = 0;
+    s->buf_len = 0;
+    s->state = AES128_EAX_STREAM_AAD;
     return 0;
 }
 
-int aes128_eax_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                       const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
-                       const uint8_t *tag, uint8_t *plain) {
-    if (key_len != AES_KEY_LEN) {
+/* Add len bytes of additional authenticated data. All AAD must be
+ * supplied before the first encrypt or decrypt call.
+ * Returns 0 on success, -1 if data has already been processed.
+ */
+int aes128_eax_stream_aad(aes128_eax_stream *s, const uint8_t *aad, size_t len) {
+    if (s->state != AES128_EAX_STREAM_AAD) {
         return -1;
     }
+    s->aad_len += len;
+    aes_cmac_absorb(&s->eax->cmac.key, s->y, s->buf, &s->buf_len, aad, len);
+    return 0;
+}
 
-    aes128_ctx ctx;
-    uint8_t k1[AES_BLK_LEN], k2[AES_BLK_LEN];
-    uint8_t n[AES_BLK_LEN], h[AES_BLK_LEN], c[AES_BLK_LEN], t[AES_BLK_LEN];
+/* Encrypt the next len bytes of the message; chunks may be any size.
+ * Returns 0 on success, -1 if the stream is finished.
+ */
+int aes128_eax_stream_encrypt(aes128_eax_stream *s, const uint8_t *plain, uint8_t *crypt, size_t len) {
+    if (s->state == AES128_EAX_STREAM_DONE) {
+        return -1;
+    }
+    if (s->state == AES128_EAX_STREAM_AAD) {
+        eax_stream_data(s);
+    }
+    eax_stream_crypt(s, plain, crypt, len, 1);
+    return 0;
+}
 
-    aes128_init_ctx(&ctx);
-    aes128_set_key(&ctx, key);
-    cmac_subkeys(&ctx, k1, k2);
+/* Decrypt the next len bytes of the message. The plaintext is released
+ * before the tag is checked: callers must not act on it until
+ * aes128_eax_stream_verify() succeeds.
+ * Returns 0 on success, -1 if the stream is finished.
+ */
+int aes128_eax_stream_decrypt(aes128_eax_stream *s, const uint8_t *crypt, uint8_t *plain, size_t len) {
+    if (s->state == AES128_EAX_STREAM_DONE) {
+        return -1;
+    }
+    if (s->state == AES128_EAX_STREAM_AAD) {
+        eax_stream_data(s);
+    }
+    eax_stream_crypt(s, crypt, plain, len, 0);
+    return 0;
+}
 
-    omac_t(n, &ctx, k1, k2, 0, nonce, nonce_len);
-    omac_t(h, &ctx, k1, k2, 1, aad, aad_len);
-    omac_t(c, &ctx, k1, k2, 2, crypt, crypt_len);
+/* Finish an encryption and write the 16-byte tag.
+ * Returns 0 on success, -1 if the stream was already finished.
+ */
+int aes128_eax_stream_final(aes128_eax_stream *s, uint8_t *tag) {
+    uint8_t c[AES_BLK_LEN];
 
+    if (s->state == AES128_EAX_STREAM_DONE) {
+        return -1;
+    }
+    if (s->state == AES128_EAX_STREAM_AAD) {
+        eax_stream_data(s);
+    }
+    omac_final(c, s->eax, 2, s->y, s->buf, s->buf_len, s->len);
     for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        t[i] = (uint8_t)(n[i] ^ h[i] ^ c[i]);
+        tag[i] = (uint8_t)(s->mask[i] ^ c[i]);
     }
+    s->state = AES128_EAX_STREAM_DONE;
+    return 0;
+}
 
-    if (!ct_eq16(tag, t)) {
-        if (crypt_len) {
-            memset(plain, 0, crypt_len);
-        }
-        return -1;
-    }
+/* Finish a decryption and check the 16-byte tag in constant time.
+ * Returns 0 if the message is authentic, -1 otherwise.
+ */
+int aes128_eax_stream_verify(aes128_eax_stream *s, const uint8_t *tag) {
+    uint8_t T[AES_BLK_LEN];
 
-    if (crypt_len) {
-        if (!eax_ctr_crypt(&ctx, n, crypt, plain, crypt_len)) {
-            return -1;
-        }
+    if (aes128_eax_stream_final(s, T)) {
+        return -1;
     }
-
-    return 0;
+    return ct_eq16(tag, T) ? 0 : -1;
 }
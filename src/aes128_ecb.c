@@ -26,6 +26,7 @@
  */
 
 #include <aes128_ecb.h>
+#include "aes128_impl.h"
 
 static inline uint32_t rotr32(uint32_t v, uint32_t n) {
     return (v >> n) | (v << (32 - n));
@@ -37,94 +38,212 @@ static inline uint32_t M(uint32_t x) {
     return ((x ^ t) << 1) ^ ((t >> 7) * 0x1b);
 }
 
+/* InvMixColumns on a single column word */
+static inline uint32_t inv_mix(uint32_t w) {
+    w ^= M(M(rotr32(w, 16) ^ w));
+    return rotr32(w, 8) ^ rotr32(w, 16) ^ rotr32(w, 24) ^ M(rotr32(w, 8) ^ w);
+}
+
 /**
- * Initializes the AES context.
- * This function builds the S-box (c->sbox) for encryption and its inverse (c->sbox_inv)
- * for decryption. It only needs to be called once per context.
+ * Initializes the AES context. The S-boxes are shared static tables, so
+ * there is nothing to build; this only clears the mode state and is kept
+ * for source compatibility. aes128_set_key() alone is enough to make a
+ * context usable.
  */
 void aes128_init_ctx(aes128_ctx* c) {
-    uint32_t x = 1, i;
-    uint8_t gf_exp[256];
+    memset(c->ctr, 0, AES_CTR_LEN);
+    memset(c->iv, 0, AES_IV_LEN);
+}
 
-    /* Build the GF(2^8) exponentiation lookup table */
-    for (i = 0; i < 256; i++) {
-        gf_exp[i] = (uint8_t)x;
-        x ^= M(x);
+void aes128_set_iv(aes128_ctx* c, const void* iv) {
+    memcpy(c->iv, iv, AES_IV_LEN);
+}
+
+
+/* SubWord for the key schedule, using the engine's own S-box where it
+   has one so that no secret-indexed loads are made outside the T-table
+   and compact builds. */
+static uint32_t sub_word(const aes128_key* k, uint32_t w) {
+#ifdef AES_DUST_AESNI
+    if (k->impl == AES_IMPL_AESNI) {
+        return aes_ni_sub_word(w);
+    }
+#else
+    (void)k;
+#endif
+#ifdef AES_DUST_CONSTANT_TIME
+    return aes_bs_sub_word(w);
+#else
+    for (uint32_t i = 0; i < 4; i++) {
+        w = (w & -256) | aes_sbox[w & 255];
+        w = rotr32(w, 8);
     }
+    return w;
+#endif
+}
 
-    /* Generate the S-box */
-    c->sbox[0] = 99;
-    
-    for (i = 0; i < 255; i++) {
-        x = gf_exp[255 - i];
-        x |= x << 8;
-        x ^= (x >> 4) ^ (x >> 5) ^ (x >> 6) ^ (x >> 7);
-        c->sbox[gf_exp[i]] = (uint8_t)((x ^ 99) & 0xFF);
+#define W(i) k->rkeys[(i) >> 2].w[(i) & 3]
+
+/* FIPS-197 key expansion for any key size, one word at a time. */
+static void expand_words(aes128_key* k, const uint8_t* mk, uint32_t nk) {
+    uint32_t i, t, nw, rc = 1;
+
+    /* The first nk words are the key itself */
+    for (i = 0; i < nk; i++) {
+        W(i) = pack32(mk + (i * 4));
     }
-    
-    /* Compute the inverse S-box */
-    for (i = 0; i < 256; i++) {
-        c->sbox_inv[c->sbox[i]] = (uint8_t)i;
+
+    /* Each further word is the word nk places back XORed with the previous
+       word, which is first rotated, substituted and combined with the
+       round constant at the start of every nk-word group. AES-256 also
+       substitutes the middle word of each group. */
+    nw = 4 * (k->rounds + 1);
+    for (; i < nw; i++) {
+        t = W(i - 1);
+        if (i % nk == 0) {
+            t = rotr32(sub_word(k, t), 8) ^ rc;
+            rc = M(rc);
+        } else if (nk > 6 && i % nk == 4) {
+            t = sub_word(k, t);
+        }
+        W(i) = W(i - nk) ^ t;
     }
 }
 
-void aes128_set_iv(aes128_ctx* c, const void* iv) {
-    memcpy(c->iv, iv, AES_IV_LEN);
+#ifdef AES_DUST_UNROLL
+/* One AES-128 schedule step: the previous round key stays in w0..w3 and
+   only the new one is stored. */
+#define EXPAND128(r, rc) \
+    w0 ^= rotr32(sub_word(k, w3), 8) ^ (rc); \
+    w1 ^= w0; w2 ^= w1; w3 ^= w2; \
+    k->rkeys[r].w[0] = w0; k->rkeys[r].w[1] = w1; \
+    k->rkeys[r].w[2] = w2; k->rkeys[r].w[3] = w3
+
+/* Speed profile: the AES-128 schedule written out with constant round
+   constants, so the generic loop's modulo tests and index arithmetic
+   disappear. */
+static void expand128(aes128_key* k, const uint8_t* mk) {
+    uint32_t w0 = pack32(mk), w1 = pack32(mk + 4);
+    uint32_t w2 = pack32(mk + 8), w3 = pack32(mk + 12);
+
+    k->rkeys[0].w[0] = w0; k->rkeys[0].w[1] = w1;
+    k->rkeys[0].w[2] = w2; k->rkeys[0].w[3] = w3;
+
+    EXPAND128(1, 0x01); EXPAND128(2, 0x02); EXPAND128(3, 0x04);
+    EXPAND128(4, 0x08); EXPAND128(5, 0x10); EXPAND128(6, 0x20);
+    EXPAND128(7, 0x40); EXPAND128(8, 0x80); EXPAND128(9, 0x1b);
+    EXPAND128(10, 0x36);
 }
 
+#undef EXPAND128
+#endif
 
 /**
- * Creates round keys for AES-128 encryption.
- * This should be called after aes128_init_ctx() and before any encryption.
+ * Expands a 16, 24 or 32-byte key into the encryption and decryption
+ * schedules for AES-128, AES-192 or AES-256.
+ * On x86 CPUs with the AES instructions the key is bound to the AES-NI
+ * engine. Constant-time builds fall back to the SSSE3 vector-permute
+ * engine where available; otherwise the portable C rounds are used.
+ *
+ * The result is never written again by any other function, so one
+ * expanded key may be shared by any number of threads and streams.
+ *
+ * @return 1 on success, or 0 if key_len is not 16, 24 or 32.
  */
-void aes128_set_key(aes128_ctx* c, const void* key) {
-    uint32_t i, w;
-    aes_key_t k;
-    aes_key_t *rk = (aes_key_t*)c->rkeys;
+int aes128_key_expand_len(aes128_key* k, const void* key, uint32_t key_len) {
+    uint32_t i, j, nk;
     const uint8_t *mk = (const uint8_t*)key;
-    
-    /* Copy master key (16 bytes = 4 words) into local buffer */
-    for (i = 0; i < 4; i++) {
-        k.w[i] = pack32(mk + (i * 4));
+
+    if (key_len != 16 && key_len != 24 && key_len != 32) {
+        return 0;
     }
-    
-    /* Generate the round keys.
-       The loop continues until the round constant (rc) equals 216.
-       This should produce the 11 round keys (44 words) required for AES-128.
-    */
-    for (uint32_t rc = 1; rc != 216; rc = M(rc)) {
-        /* Save the current key words as the next round key */
-        for (i = 0; i < 4; i++) {
-            rk->w[i] = k.w[i];
-        }
-        /* Expand the key:
-           - Rotate the last word and substitute its bytes using the S-box.
-           - Rotate the result and XOR with the round constant.
-           - XOR the result into each of the key words.
-         */
-        w = k.w[3];
-        
-        for (i = 0; i < 4; i++) {
-            w = (w & -256) | c->sbox[w & 255];
-            w = rotr32(w, 8);
+    nk = key_len / 4;
+    k->rounds = nk + 6;
+
+    k->impl = AES_IMPL_C;
+#ifdef AES_DUST_VPAES
+    if (aes_cpu_has(AES_CPU_SSSE3)) {
+        k->impl = AES_IMPL_VPAES;
+    }
+#endif
+#ifdef AES_DUST_AESNI
+    if (aes_cpu_has(AES_CPU_AESNI)) {
+        k->impl = AES_IMPL_AESNI;
+        if (nk == 4) {
+            aes_ni_set_key(k->rkeys, k->dkeys, key);
+            return 1;
         }
-        w = rotr32(w, 8) ^ rc;
-        
-        for (i = 0; i < 4; i++) {
-            w = k.w[i] ^= w;
+    }
+#endif
+
+#ifdef AES_DUST_UNROLL
+    if (nk == 4) {
+        expand128(k, mk);
+    } else {
+        expand_words(k, mk, nk);
+    }
+#else
+    expand_words(k, mk, nk);
+#endif
+
+    /* Decryption schedule for the equivalent inverse cipher: the round
+       keys in reverse order, with InvMixColumns applied to the inner
+       rounds so that decryption rounds have the same shape as encryption
+       rounds. */
+    k->dkeys[0] = k->rkeys[k->rounds];
+    for (i = 1; i < k->rounds; i++) {
+        for (j = 0; j < 4; j++) {
+            k->dkeys[i].w[j] = inv_mix(k->rkeys[k->rounds - i].w[j]);
         }
-        rk++;
     }
+    k->dkeys[k->rounds] = k->rkeys[0];
+#ifdef AES_DUST_CONSTANT_TIME
+    /* The bitsliced rounds take their keys already transposed, so that
+       single-block calls do not redo it */
+    if (k->impl == AES_IMPL_C) {
+        aes_bs_set_key(k->bskeys, k->rkeys, k->rounds);
+    }
+#endif
+    return 1;
 }
 
+#undef W
+
 /**
- * Encrypts a single 16-byte block in-place using AES-128 in ECB mode.
+ * Expands a 16-byte AES-128 key; see aes128_key_expand_len().
  */
-void aes128_ecb_encrypt(aes128_ctx* c, void* data) {
+void aes128_key_expand(aes128_key* k, const void* key) {
+    aes128_key_expand_len(k, key, AES_KEY_LEN);
+}
+
+/**
+ * Creates round keys for AES-128 encryption in the context.
+ * This must be called before any encryption.
+ */
+void aes128_set_key(aes128_ctx* c, const void* key) {
+    aes128_key_expand(&c->key, key);
+}
+
+/**
+ * Creates round keys for AES-128, AES-192 or AES-256 in the context,
+ * selected by key_len (16, 24 or 32 bytes).
+ *
+ * @return 1 on success, or 0 if key_len is not supported.
+ */
+int aes128_set_key_len(aes128_ctx* c, const void* key, uint32_t key_len) {
+    return aes128_key_expand_len(&c->key, key, key_len);
+}
+
+#if !defined(AES_DUST_TTABLES) && !defined(AES_DUST_CONSTANT_TIME)
+
+/**
+ * Compact byte-oriented encryption of a single 16-byte block.
+ */
+static void ecb_encrypt_loop(const aes128_key* k, void* data) {
     uint32_t nr = 0, i, w;
     uint8_t x[AES_BLK_LEN];
     uint8_t s[AES_BLK_LEN];
-    aes_key_t *rk = (aes_key_t*)c->rkeys;
+    const aes_key_t *rk = k->rkeys;
     
     /* Copy input block into local state */
     memcpy(x, data, AES_BLK_LEN);
@@ -139,16 +258,16 @@ void aes128_ecb_encrypt(aes128_ctx* c, void* data) {
         
         rk++;
         
-        if (nr++ == 10)
+        if (nr++ == k->rounds)
             break;
 
         // SubBytes and ShiftRows
         for (w = i = 0; i < 16; i++) {
-            x[w] = c->sbox[s[i]];
+            x[w] = aes_sbox[s[i]];
             w = (w - 3) & 15;
         }
         
-        if (nr != 10) {
+        if (nr != k->rounds) {
             // MixColumns
             for (i = 0; i < 4; i++) {
                 w = pack32(x + (i * 4));
@@ -162,46 +281,213 @@ void aes128_ecb_encrypt(aes128_ctx* c, void* data) {
 }
 
 /**
- * Decrypts a single 16-byte block in-place using AES-128 in ECB mode.
+ * Compact byte-oriented decryption of a single 16-byte block, using the
+ * equivalent inverse cipher so the loop mirrors encryption.
  */
-void aes128_ecb_decrypt(aes128_ctx* c, void* data) {
-    uint32_t nr = 10, i, w;
+static void ecb_decrypt_loop(const aes128_key* k, void* data) {
+    uint32_t nr = 0, i, w;
     uint8_t x[AES_BLK_LEN];
     uint8_t s[AES_BLK_LEN];
-    aes_key_t *rk = (aes_key_t*)&c->rkeys[10];
+    const aes_key_t *dk = k->dkeys;
 
-    memcpy(s, data, AES_BLK_LEN);
-    for (i = 0; i < 4; i++) {
-        uint32_t v = pack32(s + (i * 4)) ^ rk->w[i];
-        unpack32(v, s + (i * 4));
-    }
+    memcpy(x, data, AES_BLK_LEN);
 
     for (;;) {
-        rk--;
-        
-        // InvSubBytes and InvShiftRows
-        for (w = i = 0; i < 16; i++) {
-            x[i] = c->sbox_inv[s[w]];
-            w = (w - 3) & 15;
-        }
-        
         // AddRoundKey
         for (i = 0; i < 4; i++) {
-            uint32_t v = pack32(x + (i * 4)) ^ rk->w[i];
+            uint32_t v = pack32(x + (i * 4)) ^ dk->w[i];
             unpack32(v, s + (i * 4));
         }
-        
-        if (--nr == 0)
+
+        dk++;
+
+        if (nr++ == k->rounds)
             break;
-        
-        // InvMixColumns
-        for (i = 0; i < 4; i++) {
-            w = pack32(s + (i * 4));
-            w ^= M(M(rotr32(w, 16) ^ w));
-            w = rotr32(w, 8) ^ rotr32(w, 16) ^ rotr32(w, 24) ^ M(rotr32(w, 8) ^ w);
-            unpack32(w, s + (i * 4));
+
+        // InvSubBytes and InvShiftRows
+        for (w = i = 0; i < 16; i++) {
+            x[i] = aes_sbox_inv[s[w]];
+            w = (w - 3) & 15;
+        }
+
+        if (nr != k->rounds) {
+            // InvMixColumns
+            for (i = 0; i < 4; i++) {
+                w = inv_mix(pack32(x + (i * 4)));
+                unpack32(w, x + (i * 4));
+            }
         }
     }
 
     memcpy(data, s, AES_BLK_LEN);
 }
+
+#endif /* compact loop */
+
+/**
+ * Encrypts a single 16-byte block in-place with an expanded key.
+ */
+void aes128_key_encrypt(const aes128_key* k, void* data) {
+#ifdef AES_DUST_AESNI
+    if (k->impl == AES_IMPL_AESNI) {
+        aes_ni_encrypt(k->rkeys, k->rounds, data);
+        return;
+    }
+#endif
+#ifdef AES_DUST_VPAES
+    if (k->impl == AES_IMPL_VPAES) {
+        aes_vp_encrypt(k->rkeys, k->rounds, data);
+        return;
+    }
+#endif
+#if defined(AES_DUST_CONSTANT_TIME)
+    aes_bs_encrypt(k->bskeys, k->rounds, data, data, 1);
+#elif defined(AES_DUST_TTABLES)
+    aes_tt_encrypt(k->rkeys, k->rounds, data);
+#else
+    ecb_encrypt_loop(k, data);
+#endif
+}
+
+/**
+ * Decrypts a single 16-byte block in-place with an expanded key.
+ */
+void aes128_key_decrypt(const aes128_key* k, void* data) {
+#ifdef AES_DUST_AESNI
+    if (k->impl == AES_IMPL_AESNI) {
+        aes_ni_decrypt(k->dkeys, k->rounds, data);
+        return;
+    }
+#endif
+#ifdef AES_DUST_VPAES
+    if (k->impl == AES_IMPL_VPAES) {
+        aes_vp_decrypt(k->rkeys, k->rounds, data);
+        return;
+    }
+#endif
+#if defined(AES_DUST_CONSTANT_TIME)
+    aes_bs_decrypt(k->bskeys, k->rounds, data, data, 1);
+#elif defined(AES_DUST_TTABLES)
+    aes_tt_decrypt(k->dkeys, k->rounds, data);
+#else
+    ecb_decrypt_loop(k, data);
+#endif
+}
+
+/**
+ * Encrypts nblocks independent 16-byte blocks from in to out. The buffers
+ * may be identical but must not otherwise overlap. Each engine keeps
+ * several blocks in flight per round, so this is the fast path for any
+ * mode whose block cipher calls do not depend on each other.
+ */
+void aes128_key_encrypt_blocks(const aes128_key* k, const void* in, void* out, uint32_t nblocks) {
+    const uint8_t *src = (const uint8_t*)in;
+    uint8_t *dst = (uint8_t*)out;
+
+#ifdef AES_DUST_AESNI
+    if (k->impl == AES_IMPL_AESNI) {
+        aes_ni_encrypt_blocks(k->rkeys, k->rounds, src, dst, nblocks);
+        return;
+    }
+#endif
+#ifdef AES_DUST_VPAES
+    if (k->impl == AES_IMPL_VPAES) {
+        aes_vp_encrypt_blocks(k->rkeys, k->rounds, src, dst, nblocks);
+        return;
+    }
+#endif
+#if defined(AES_DUST_CONSTANT_TIME)
+    aes_bs_encrypt(k->bskeys, k->rounds, src, dst, nblocks);
+#elif defined(AES_DUST_TTABLES)
+    aes_tt_encrypt_blocks(k->rkeys, k->rounds, src, dst, nblocks);
+#else
+    for (uint32_t i = 0; i < nblocks; i++) {
+        if (src != dst) {
+            memcpy(dst, src, AES_BLK_LEN);
+        }
+        ecb_encrypt_loop(k, dst);
+        src += AES_BLK_LEN;
+        dst += AES_BLK_LEN;
+    }
+#endif
+}
+
+/**
+ * Decrypts nblocks independent 16-byte blocks from in to out, with the same
+ * aliasing rules as aes128_key_encrypt_blocks().
+ */
+void aes128_key_decrypt_blocks(const aes128_key* k, const void* in, void* out, uint32_t nblocks) {
+    const uint8_t *src = (const uint8_t*)in;
+    uint8_t *dst = (uint8_t*)out;
+
+#ifdef AES_DUST_AESNI
+    if (k->impl == AES_IMPL_AESNI) {
+        aes_ni_decrypt_blocks(k->dkeys, k->rounds, src, dst, nblocks);
+        return;
+    }
+#endif
+#ifdef AES_DUST_VPAES
+    if (k->impl == AES_IMPL_VPAES) {
+        aes_vp_decrypt_blocks(k->rkeys, k->rounds, src, dst, nblocks);
+        return;
+    }
+#endif
+#if defined(AES_DUST_CONSTANT_TIME)
+    aes_bs_decrypt(k->bskeys, k->rounds, src, dst, nblocks);
+#elif defined(AES_DUST_TTABLES)
+    aes_tt_decrypt_blocks(k->dkeys, k->rounds, src, dst, nblocks);
+#else
+    for (uint32_t i = 0; i < nblocks; i++) {
+        if (src != dst) {
+            memcpy(dst, src, AES_BLK_LEN);
+        }
+        ecb_decrypt_loop(k, dst);
+        src += AES_BLK_LEN;
+        dst += AES_BLK_LEN;
+    }
+#endif
+}
+
+/**
+ * Encrypts a single 16-byte block in-place using AES-128 in ECB mode.
+ */
+void aes128_ecb_encrypt(aes128_ctx* c, void* data) {
+    aes128_key_encrypt(&c->key, data);
+}
+
+/**
+ * Decrypts a single 16-byte block in-place using AES-128 in ECB mode.
+ */
+void aes128_ecb_decrypt(aes128_ctx* c, void* data) {
+    aes128_key_decrypt(&c->key, data);
+}
+
+/**
+ * Encrypts nblocks independent blocks from in to out; see
+ * aes128_key_encrypt_blocks().
+ */
+void aes128_ecb_encrypt_blocks(aes128_ctx* c, const void* in, void* out, uint32_t nblocks) {
+    aes128_key_encrypt_blocks(&c->key, in, out, nblocks);
+}
+
+/**
+ * Decrypts nblocks independent blocks from in to out; see
+ * aes128_key_decrypt_blocks().
+ */
+void aes128_ecb_decrypt_blocks(aes128_ctx* c, const void* in, void* out, uint32_t nblocks) {
+    aes128_key_decrypt_blocks(&c->key, in, out, nblocks);
+}
+
+/**
+ * Binds a stream to a shared expanded key and clears its IV and counter.
+ * The key must outlive the stream and is only ever read through it.
+ */
+void aes128_stream_init(aes128_stream* s, const aes128_key* key) {
+    s->key = key;
+    memset(s->ctr, 0, AES_CTR_LEN);
+    memset(s->iv, 0, AES_IV_LEN);
+}
+
+void aes128_stream_set_iv(aes128_stream* s, const void* iv) {
+    memcpy(s->iv, iv, AES_IV_LEN);
+}
@@ -26,9 +26,14 @@
  */
 
 #include <aes128_gcm.h>
+#include "aes128_impl.h"
 
-#ifndef BIT
-#define BIT(x) (1U << (x))
+#ifdef AES_DUST_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
 #endif
 
 /* --- Utility functions for Big-Endian conversions --- */
@@ -43,13 +48,6 @@ static inline void PUT_BE32(uint8_t *a, uint32_t val) {
     a[3] = (uint8_t)(val & 0xff);
 }
 
-static inline uint64_t GET_BE64(const uint8_t *a) {
-    return (((uint64_t)a[0]) << 56) | (((uint64_t)a[1]) << 48) |
-           (((uint64_t)a[2]) << 40) | (((uint64_t)a[3]) << 32) |
-           (((uint64_t)a[4]) << 24) | (((uint64_t)a[5]) << 16) |
-           (((uint64_t)a[6]) << 8)  | ((uint64_t)a[7]);
-}
-
 static inline void PUT_BE64(uint8_t *a, uint64_t val) {
     for (int i = 7; i >= 0; --i) {
         a[i] = (uint8_t)(val & 0xff);
@@ -73,59 +71,26 @@ static void inc32(uint8_t *block) {
 }
 
 /* Check if a 32-bit counter can cover len bytes without wrapping. */
-static int gcm_ctr_ok(uint32_t len, const uint8_t *J0) {
+static int gcm_ctr_ok(uint64_t len, const uint8_t *J0) {
     if (len == 0) {
         return 1;
     }
-    uint64_t blocks = ((uint64_t)len + AES_BLK_LEN - 1) / AES_BLK_LEN;
+    uint64_t blocks = (len + AES_BLK_LEN - 1) / AES_BLK_LEN;
     uint32_t ctr = GET_BE32(J0 + 12);
     uint64_t remaining = 0xFFFFFFFFu - ctr;
     return blocks <= remaining;
 }
 
-/* XOR two 16-byte blocks (dst ^= src). */
-static void xor_block(uint8_t *dst, const uint8_t *src) {
-    for (int i = 0; i < AES_BLK_LEN; i++) {
-        dst[i] ^= src[i];
-    }
+/* AAD is limited to 2^64 - 1 bits (SP 800-38D, section 5.2.1.1). */
+static int gcm_aad_ok(uint64_t len) {
+    return len < ((uint64_t)1 << 61);
 }
 
-/* Shift a 16-byte block right by one bit.
- * This function treats the block as four 32-bit big-endian words.
+/* Whether len more AAD bytes fit after have bytes, without letting the
+ * sum wrap first.
  */
-static void shift_right_block(uint8_t *v) {
-    uint32_t val;
-    for (int i = 12; i >= 0; i -= 4) {
-        val = GET_BE32(v + i);
-        val >>= 1;
-        if (i > 0 && (v[i - 1] & 0x01))
-            val |= 0x80000000;
-        PUT_BE32(v + i, val);
-    }
-}
-
-/* Multiply two 128-bit values (x and y) in GF(2^128) as used in GCM.
- * z = x * y.
- */
-static void gf_mult(const uint8_t *x, const uint8_t *y, uint8_t *z) {
-    uint8_t v[16];
-    int i, j;
-    memset(z, 0, AES_BLK_LEN);
-    memcpy(v, y, AES_BLK_LEN);
-
-    for (i = 0; i < AES_BLK_LEN; i++) {
-        for (j = 0; j < 8; j++) {
-            if (x[i] & BIT(7 - j)) {
-                xor_block(z, v);
-            }
-            if (v[15] & 0x01) {
-                shift_right_block(v);
-                v[0] ^= 0xe1;
-            } else {
-                shift_right_block(v);
-            }
-        }
-    }
+static int gcm_aad_more_ok(uint64_t have, uint64_t len) {
+    return gcm_aad_ok(have) && len < ((uint64_t)1 << 61) - have;
 }
 
 /* Initialize a GHASH accumulator to zero. */
@@ -136,86 +101,74 @@ static void ghash_start(uint8_t *y) {
 /* Compute GHASH(H, X) where X is xlen bytes.
  * The result is accumulated in y.
  */
-static void ghash(const uint8_t *h, const uint8_t *x, uint32_t xlen, uint8_t *y) {
-    uint32_t m = xlen / AES_BLK_LEN;
-    const uint8_t *xpos = x;
+static void ghash(const aes128_gcm_ctx *c, const uint8_t *x, size_t xlen, uint8_t *y) {
+    size_t m = xlen / AES_BLK_LEN;
     uint8_t tmp[AES_BLK_LEN];
 
-    for (uint32_t i = 0; i < m; i++) {
-        xor_block(y, xpos);
-        xpos += AES_BLK_LEN;
-        gf_mult(y, h, tmp);
-        memcpy(y, tmp, AES_BLK_LEN);
-    }
+    aes_ghash_update(&c->gf, y, x, m);
 
     /* Process any remaining partial block */
-    uint32_t rem = xlen & (AES_BLK_LEN - 1);
+    size_t rem = xlen & (AES_BLK_LEN - 1);
     if (rem) {
-        memcpy(tmp, xpos, rem);
+        memcpy(tmp, x + m * AES_BLK_LEN, rem);
         memset(tmp + rem, 0, AES_BLK_LEN - rem);
-        xor_block(y, tmp);
-        gf_mult(y, h, tmp);
-        memcpy(y, tmp, AES_BLK_LEN);
+        aes_ghash_update(&c->gf, y, tmp, 1);
     }
 }
 
-/* GCTR function as specified in GCM.
- * Given an initial counter block (icb), encrypt x (of length xlen bytes)
- * to produce output y.
+/* Encrypt x (of length xlen bytes) to y under the counter blocks starting
+ * at cb, leaving cb at the first unused counter.
  */
-static void aes_gctr(void *ctx, const uint8_t *icb, const uint8_t *x, uint32_t xlen, uint8_t *y) {
-    uint32_t n = xlen / AES_BLK_LEN;
-    uint32_t last = xlen % AES_BLK_LEN;
-    uint8_t cb[AES_BLK_LEN], tmp[AES_BLK_LEN];
+static void gctr_run(const aes128_key *key, uint8_t *cb, const uint8_t *x, size_t xlen, uint8_t *y) {
+    uint8_t tmp[AES_PAR_BLOCKS * AES_BLK_LEN];
     const uint8_t *xpos = x;
     uint8_t *ypos = y;
 
-    if (xlen == 0)
-        return;
-
-    memcpy(cb, icb, AES_BLK_LEN);
+    while (xlen) {
+        uint32_t n = (xlen + AES_BLK_LEN - 1) / AES_BLK_LEN;
+        if (n > AES_PAR_BLOCKS) {
+            n = AES_PAR_BLOCKS;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            memcpy(tmp + (i * AES_BLK_LEN), cb, AES_BLK_LEN);
+            inc32(cb);
+        }
+        aes128_key_encrypt_blocks(key, tmp, tmp, n);
 
-    for (uint32_t i = 0; i < n; i++) {
-        memcpy(ypos, cb, AES_BLK_LEN);
-        aes128_ecb_encrypt(ctx, ypos);
-        xor_block(ypos, xpos);
-        xpos += AES_BLK_LEN;
-        ypos += AES_BLK_LEN;
-        inc32(cb);
-    }
-
-    if (last) {
-        memcpy(tmp, cb, AES_BLK_LEN);
-        aes128_ecb_encrypt(ctx, tmp);
-        for (uint32_t i = 0; i < last; i++) {
+        size_t run = n * AES_BLK_LEN;
+        if (run > xlen) {
+            run = xlen;
+        }
+        for (size_t i = 0; i < run; i++) {
             ypos[i] = xpos[i] ^ tmp[i];
         }
+        xpos += run;
+        ypos += run;
+        xlen -= run;
     }
 }
 
-/* --- Initialization Helpers --- */
+/* GCTR function as specified in GCM.
+ * Given an initial counter block (icb), encrypt x (of length xlen bytes)
+ * to produce output y.
+ */
+static void aes_gctr(const aes128_key *key, const uint8_t *icb, const uint8_t *x, size_t xlen, uint8_t *y) {
+    uint8_t cb[AES_BLK_LEN];
 
-/* Initialize the AES context with the given key. */
-static void aes_encrypt_init(aes128_ctx *ctx, const uint8_t *key, uint32_t key_len) {
-    (void)key_len;
-    aes128_init_ctx(ctx);
-    aes128_set_key(ctx, key);
-}
+    if (xlen == 0)
+        return;
 
-/* Initialize the hash subkey H for GCM.
- * H = AES-128(0^128)
- */
-static void aes_gcm_init_hash_subkey(aes128_ctx *ctx, const uint8_t *key, uint32_t key_len, uint8_t *H) {
-    aes_encrypt_init(ctx, key, key_len);
-    memset(H, 0, AES_BLK_LEN);
-    aes128_ecb_encrypt(ctx, H);
+    memcpy(cb, icb, AES_BLK_LEN);
+    gctr_run(key, cb, x, xlen, y);
 }
 
+/* --- Initialization Helpers --- */
+
 /* Prepare the pre-counter block J0.
  * If IV is 12 bytes, then J0 = IV || 0x00000001.
  * Otherwise, J0 = GHASH(H, IV || padding || [0^64 || (IV_bit_length)]).
  */
-static void aes_gcm_prepare_j0(const uint8_t *iv, uint32_t iv_len, const uint8_t *H, uint8_t *J0) {
+static void aes_gcm_prepare_j0(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len, uint8_t *J0) {
     uint8_t len_buf[AES_BLK_LEN];
 
     if (iv_len == 12) {
@@ -224,43 +177,217 @@ static void aes_gcm_prepare_j0(const uint8_t *iv, uint32_t iv_len, const uint8_t
         J0[AES_BLK_LEN - 1] = 0x01;
     } else {
         ghash_start(J0);
-        ghash(H, iv, iv_len, J0);
+        ghash(c, iv, iv_len, J0);
         PUT_BE64(len_buf, 0);
         PUT_BE64(len_buf + 8, (uint64_t)iv_len * 8);
-        ghash(H, len_buf, AES_BLK_LEN, J0);
+        ghash(c, len_buf, AES_BLK_LEN, J0);
+    }
+}
+
+/* One pass of CTR and GHASH over n whole blocks: each batch is encrypted
+ * and hashed while it is still in cache. enc says whether the output
+ * (encryption) or the input (decryption) is the ciphertext. cb is the next
+ * counter block and y the GHASH accumulator; both are advanced.
+ */
+static void gcm_crypt_blocks(const aes128_gcm_ctx *c, uint8_t *cb, uint8_t *y,
+                             const uint8_t *in, uint8_t *out, size_t n, int enc) {
+#ifdef AES_DUST_CLMUL
+    if (c->key.impl == AES_IMPL_AESNI && c->gf.impl == AES_GF_CLMUL) {
+        size_t m = n & ~(size_t)(AES_PAR_BLOCKS - 1);
+        if (enc) {
+            aes_clmul_gcm_encrypt(c->key.rkeys, c->key.rounds, &c->gf, cb, y, in, out, m);
+        } else {
+            aes_clmul_gcm_decrypt(c->key.rkeys, c->key.rounds, &c->gf, cb, y, in, out, m);
+        }
+        in += m * AES_BLK_LEN;
+        out += m * AES_BLK_LEN;
+        n -= m;
+    }
+#endif
+    while (n) {
+        size_t m = n < AES_PAR_BLOCKS ? n : AES_PAR_BLOCKS;
+        if (!enc) {
+            aes_ghash_update(&c->gf, y, in, m);
+        }
+        gctr_run(&c->key, cb, in, m * AES_BLK_LEN, out);
+        if (enc) {
+            aes_ghash_update(&c->gf, y, out, m);
+        }
+        in += m * AES_BLK_LEN;
+        out += m * AES_BLK_LEN;
+        n -= m;
     }
 }
 
-/* A helper that increments J0 and then calls GCTR.
+/* Encrypt or decrypt len bytes after J0 and hash the ciphertext into S,
+ * in a single pass.
  */
-static void aes_gcm_gctr(void *aes, const uint8_t *J0, const uint8_t *in, uint32_t len, uint8_t *out) {
-    uint8_t J0inc[AES_BLK_LEN];
+static void gcm_crypt(const aes128_gcm_ctx *c, const uint8_t *J0, uint8_t *S,
+                      const uint8_t *in, uint8_t *out, size_t len, int enc) {
+    uint8_t cb[AES_BLK_LEN];
+    size_t full = len / AES_BLK_LEN, rem = len & (AES_BLK_LEN - 1);
 
-    if (len == 0)
-        return;
+    memcpy(cb, J0, AES_BLK_LEN);
+    inc32(cb);
+    gcm_crypt_blocks(c, cb, S, in, out, full, enc);
 
-    memcpy(J0inc, J0, AES_BLK_LEN);
-    inc32(J0inc);
-    aes_gctr(aes, J0inc, in, len, out);
+    if (rem) {
+        in += full * AES_BLK_LEN;
+        out += full * AES_BLK_LEN;
+        if (!enc) {
+            ghash(c, in, rem, S);
+        }
+        gctr_run(&c->key, cb, in, rem, out);
+        if (enc) {
+            ghash(c, out, rem, S);
+        }
+    }
 }
 
-/* Compute GHASH over AAD and ciphertext.
- * S = GHASH(H, AAD || C || [bit lengths])
- */
-static void aes_gcm_ghash(const uint8_t *H, const uint8_t *aad, uint32_t aad_len,
-                          const uint8_t *crypt, uint32_t crypt_len, uint8_t *S) {
+/* Finish GHASH with the bit lengths block [len(A)]64 || [len(C)]64. */
+static void gcm_ghash_lens(const aes128_gcm_ctx *c, uint8_t *S, uint64_t aad_len, uint64_t crypt_len) {
     uint8_t len_buf[AES_BLK_LEN];
 
-    ghash_start(S);
-    ghash(H, aad, aad_len, S);
-    ghash(H, crypt, crypt_len, S);
-    PUT_BE64(len_buf, (uint64_t)aad_len * 8);
-    PUT_BE64(len_buf + 8, (uint64_t)crypt_len * 8);
-    ghash(H, len_buf, AES_BLK_LEN, S);
+    PUT_BE64(len_buf, aad_len * 8);
+    PUT_BE64(len_buf + 8, crypt_len * 8);
+    aes_ghash_update(&c->gf, S, len_buf, 1);
+}
+
+/* Finish GHASH and compute the tag
+ * T = E(K, J0) ^ GHASH(H, A || C || [len(A)]64 || [len(C)]64).
+ */
+static void gcm_tag(const aes128_gcm_ctx *c, const uint8_t *J0, uint8_t *S,
+                    uint64_t aad_len, uint64_t crypt_len, uint8_t *tag) {
+    gcm_ghash_lens(c, S, aad_len, crypt_len);
+    aes_gctr(&c->key, J0, S, AES_BLK_LEN, tag);
 }
 
 /* --- GCM Public Functions --- */
 
+/* Set up a GCM context for a 16, 24 or 32-byte key: expands the key,
+ * derives H = AES-K(0^128) and precomputes its powers for GHASH.
+ * Returns 0 on success, -1 if key_len is invalid.
+ */
+int aes128_gcm_init(aes128_gcm_ctx *c, const uint8_t *key, uint32_t key_len) {
+    uint8_t H[AES_BLK_LEN];
+
+    if (!aes128_key_expand_len(&c->key, key, key_len)) {
+        return -1;
+    }
+    memset(H, 0, AES_BLK_LEN);
+    aes128_key_encrypt(&c->key, H);
+    aes_ghash_init(&c->gf, H);
+    return 0;
+}
+
+/* Start GHASH from the prefix midstate p, or from zero if p is NULL,
+ * and check the total AAD length. Returns the prefix length, or -1 if
+ * the AAD is too long.
+ */
+static int64_t gcm_start(const aes128_gcm_prefix *p, uint8_t *S, size_t aad_len) {
+    if (!p) {
+        ghash_start(S);
+        return gcm_aad_ok(aad_len) ? 0 : -1;
+    }
+    memcpy(S, p->s, AES_BLK_LEN);
+    return gcm_aad_more_ok(p->len, aad_len) ? (int64_t)p->len : -1;
+}
+
+static int gcm_seal(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p, const uint8_t *iv, uint32_t iv_len,
+                    const uint8_t *plain, size_t plain_len, const uint8_t *aad, size_t aad_len,
+                    uint8_t *crypt, uint8_t *tag) {
+    uint8_t J0[AES_BLK_LEN], S[AES_BLK_LEN];
+    int64_t pre;
+
+    aes_gcm_prepare_j0(c, iv, iv_len, J0);
+    pre = gcm_start(p, S, aad_len);
+    if (!gcm_ctr_ok(plain_len, J0) || pre < 0) {
+        return -1;
+    }
+    ghash(c, aad, aad_len, S);
+    gcm_crypt(c, J0, S, plain, crypt, plain_len, 1);
+    gcm_tag(c, J0, S, (uint64_t)pre + aad_len, plain_len, tag);
+
+    return 0;
+}
+
+static int gcm_open(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p, const uint8_t *iv, uint32_t iv_len,
+                    const uint8_t *crypt, size_t crypt_len, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *tag, uint8_t *plain) {
+    uint8_t J0[AES_BLK_LEN], S[AES_BLK_LEN], T[AES_BLK_LEN];
+    int64_t pre;
+
+    aes_gcm_prepare_j0(c, iv, iv_len, J0);
+    pre = gcm_start(p, S, aad_len);
+    if (!gcm_ctr_ok(crypt_len, J0) || pre < 0) {
+        return -1;
+    }
+    ghash(c, aad, aad_len, S);
+    gcm_crypt(c, J0, S, crypt, plain, crypt_len, 0);
+    gcm_tag(c, J0, S, (uint64_t)pre + aad_len, crypt_len, T);
+
+    if (!ct_eq16(tag, T)) {
+        if (crypt_len) {
+            memset(plain, 0, crypt_len);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/* GCM encryption under a context set up by aes128_gcm_init().
+ * Arguments and result are those of aes128_gcm_encrypt() without the key.
+ */
+int aes128_gcm_encrypt_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+                           const uint8_t *plain, size_t plain_len, const uint8_t *aad, size_t aad_len,
+                           uint8_t *crypt, uint8_t *tag) {
+    return gcm_seal(c, NULL, iv, iv_len, plain, plain_len, aad, aad_len, crypt, tag);
+}
+
+/* GCM decryption under a context set up by aes128_gcm_init().
+ * Arguments and result are those of aes128_gcm_decrypt() without the key.
+ * Decryption and authentication share one pass, so on failure the
+ * plaintext buffer is zeroed rather than left untouched.
+ */
+int aes128_gcm_decrypt_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+                           const uint8_t *crypt, size_t crypt_len, const uint8_t *aad, size_t aad_len,
+                           const uint8_t *tag, uint8_t *plain) {
+    return gcm_open(c, NULL, iv, iv_len, crypt, crypt_len, aad, aad_len, tag, plain);
+}
+
+/* Hash an AAD prefix shared by many messages under c. len must be a
+ * multiple of 16 so that the midstate ends on a block boundary.
+ * Returns 0 on success, -1 if len is unaligned or too long.
+ */
+int aes128_gcm_prefix_init(const aes128_gcm_ctx *c, aes128_gcm_prefix *p, const uint8_t *aad, size_t len) {
+    if ((len & (AES_BLK_LEN - 1)) || !gcm_aad_ok(len)) {
+        return -1;
+    }
+    ghash_start(p->s);
+    aes_ghash_update(&c->gf, p->s, aad, len / AES_BLK_LEN);
+    p->len = len;
+    return 0;
+}
+
+/* As aes128_gcm_encrypt_ctx(), with AAD made of the prefix p followed
+ * by aad; only aad and the plaintext are hashed. p must come from
+ * aes128_gcm_prefix_init() with the same context.
+ */
+int aes128_gcm_encrypt_prefix(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p,
+                              const uint8_t *iv, uint32_t iv_len, const uint8_t *plain, size_t plain_len,
+                              const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t *tag) {
+    return gcm_seal(c, p, iv, iv_len, plain, plain_len, aad, aad_len, crypt, tag);
+}
+
+/* As aes128_gcm_decrypt_ctx(), with AAD made of the prefix p followed
+ * by aad.
+ */
+int aes128_gcm_decrypt_prefix(const aes128_gcm_ctx *c, const aes128_gcm_prefix *p,
+                              const uint8_t *iv, uint32_t iv_len, const uint8_t *crypt, size_t crypt_len,
+                              const uint8_t *aad, size_t aad_len, const uint8_t *tag, uint8_t *plain) {
+    return gcm_open(c, p, iv, iv_len, crypt, crypt_len, aad, aad_len, tag, plain);
+}
+
 /* AES-128 GCM Encryption.
  * Inputs:
  *   key, key_len: AES key.
@@ -273,25 +400,14 @@ static void aes_gcm_ghash(const uint8_t *H, const uint8_t *aad, uint32_t aad_len
  * Returns 0 on success.
  */
 int aes128_gcm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
-                       const uint8_t *plain, uint32_t plain_len, const uint8_t *aad, uint32_t aad_len,
+                       const uint8_t *plain, size_t plain_len, const uint8_t *aad, size_t aad_len,
                        uint8_t *crypt, uint8_t *tag) {
-    uint8_t H[AES_BLK_LEN], J0[AES_BLK_LEN], S[AES_BLK_LEN];
-    aes128_ctx ctx;
+    aes128_gcm_ctx c;
 
-    if (key_len != AES_KEY_LEN) {
+    if (aes128_gcm_init(&c, key, key_len)) {
         return -1;
     }
-
-    aes_gcm_init_hash_subkey(&ctx, key, key_len, H);
-    aes_gcm_prepare_j0(iv, iv_len, H, J0);
-    if (!gcm_ctr_ok(plain_len, J0)) {
-        return -1;
-    }
-    aes_gcm_gctr(&ctx, J0, plain, plain_len, crypt);
-    aes_gcm_ghash(H, aad, aad_len, crypt, plain_len, S);
-    aes_gctr(&ctx, J0, S, AES_BLK_LEN, tag);
-
-    return 0;
+    return aes128_gcm_encrypt_ctx(&c, iv, iv_len, plain, plain_len, aad, aad_len, crypt, tag);
 }
 
 /* AES-128 GCM Decryption.
@@ -303,30 +419,715 @@ int aes128_gcm_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *iv,
  *   tag: Authentication tag (16 bytes).
  * Outputs:
  *   plain: Decrypted plaintext (same length as ciphertext).
- * Returns 0 if authentication succeeds, -1 if authentication fails.
+ * Returns 0 if authentication succeeds, -1 if authentication fails
+ * (plain is then zeroed).
  */
 int aes128_gcm_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
-                       const uint8_t *crypt, uint32_t crypt_len, const uint8_t *aad, uint32_t aad_len,
+                       const uint8_t *crypt, size_t crypt_len, const uint8_t *aad, size_t aad_len,
                        const uint8_t *tag, uint8_t *plain) {
-    uint8_t H[AES_BLK_LEN], J0[AES_BLK_LEN], S[AES_BLK_LEN], T[AES_BLK_LEN];
-    aes128_ctx ctx;
+    aes128_gcm_ctx c;
+
+    if (aes128_gcm_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_gcm_decrypt_ctx(&c, iv, iv_len, crypt, crypt_len, aad, aad_len, tag, plain);
+}
+
+/* --- Deterministic IVs --- */
+
+/* Largest invocation limit: aes128_gcm_nonce_next() pushes the shared
+   counter one past the limit per failed call, and this keeps it from
+   ever wrapping. */
+#define GCM_NONCE_MAX ((uint64_t)1 << 63)
+
+/* Relaxed atomics on the shared counter: uniqueness needs atomicity
+   only, not ordering. Without compiler support they are plain accesses,
+   and a generator must not be shared between threads. */
+static inline uint64_t gcm_load(uint64_t *p) {
+#if defined(_MSC_VER)
+    return (uint64_t)_InterlockedOr64((volatile __int64 *)p, 0);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+    return *p;
+#endif
+}
+
+/* Add v to *p and return the old value. */
+static inline uint64_t gcm_fetch_add(uint64_t *p, uint64_t v) {
+#if defined(_MSC_VER)
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)v);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+#else
+    uint64_t old = *p;
+    *p = old + v;
+    return old;
+#endif
+}
+
+/* Set *p to want if it still holds old; returns whether it did. */
+static inline int gcm_cas(uint64_t *p, uint64_t old, uint64_t want) {
+#if defined(_MSC_VER)
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, (__int64)want, (__int64)old) == old;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_compare_exchange_n(p, &old, want, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#else
+    if (*p != old) {
+        return 0;
+    }
+    *p = want;
+    return 1;
+#endif
+}
+
+/* IV = fixed || [ctr]64 */
+static void gcm_nonce_iv(const uint8_t fixed[4], uint64_t ctr, uint8_t iv[12]) {
+    memcpy(iv, fixed, 4);
+    PUT_BE64(iv + 4, ctr);
+}
+
+/* Bind a generator to the keyed context c. limit is the number of IVs
+ * it may hand out, at most 2^63; 0 means 2^63. Across all generators
+ * for one key, fixed fields must differ.
+ * Returns 0 on success.
+ */
+int aes128_gcm_nonce_init(aes128_gcm_nonce *n, const aes128_gcm_ctx *c,
+                          const uint8_t fixed[4], uint64_t limit) {
+    n->next = 0;
+    n->limit = (limit == 0 || limit > GCM_NONCE_MAX) ? GCM_NONCE_MAX : limit;
+    n->gcm = c;
+    memcpy(n->fixed, fixed, 4);
+    return 0;
+}
+
+/* Write the next unused 12-byte IV. Safe to call from many threads.
+ * Returns 0 on success, -1 once the limit is reached.
+ */
+int aes128_gcm_nonce_next(aes128_gcm_nonce *n, uint8_t iv[12]) {
+    uint64_t ctr = gcm_fetch_add(&n->next, 1);
+
+    if (ctr >= n->limit) {
+        return -1;
+    }
+    gcm_nonce_iv(n->fixed, ctr, iv);
+    return 0;
+}
+
+/* Reserve count consecutive IVs for one thread, which then draws them
+ * with aes128_gcm_nonce_range_next() and no shared writes. Safe to
+ * call from many threads.
+ * Returns 0 on success, -1 if count is 0 or fewer than count IVs are
+ * left.
+ */
+int aes128_gcm_nonce_reserve(aes128_gcm_nonce *n, uint64_t count, aes128_gcm_nonce_range *r) {
+    uint64_t ctr;
 
-    if (key_len != AES_KEY_LEN) {
+    if (count == 0) {
         return -1;
     }
+    /* Compare-and-swap rather than add, so a request that does not fit
+       leaves the counter alone and the remaining IVs stay usable */
+    do {
+        ctr = gcm_load(&n->next);
+        if (ctr >= n->limit || count > n->limit - ctr) {
+            return -1;
+        }
+    } while (!gcm_cas(&n->next, ctr, ctr + count));
+    r->next = ctr;
+    r->end = ctr + count;
+    r->gcm = n->gcm;
+    memcpy(r->fixed, n->fixed, 4);
+    return 0;
+}
 
-    aes_gcm_init_hash_subkey(&ctx, key, key_len, H);
-    aes_gcm_prepare_j0(iv, iv_len, H, J0);
-    if (!gcm_ctr_ok(crypt_len, J0)) {
+/* Write the next IV of a reserved range.
+ * Returns 0 on success, -1 once the range is used up.
+ */
+int aes128_gcm_nonce_range_next(aes128_gcm_nonce_range *r, uint8_t iv[12]) {
+    if (r->next >= r->end) {
         return -1;
     }
-    aes_gcm_ghash(H, aad, aad_len, crypt, crypt_len, S);
-    aes_gctr(&ctx, J0, S, AES_BLK_LEN, T);
+    gcm_nonce_iv(r->fixed, r->next++, iv);
+    return 0;
+}
 
-    if (!ct_eq16(tag, T)) {
+/* Encrypt under the generator's key with its next IV, which is written
+ * to iv for the receiver. Other arguments are those of
+ * aes128_gcm_encrypt_ctx().
+ * Returns 0 on success, -1 if the IVs are exhausted or the lengths are
+ * invalid.
+ */
+int aes128_gcm_encrypt_next(aes128_gcm_nonce *n, const uint8_t *plain, size_t plain_len,
+                            const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t iv[12], uint8_t *tag) {
+    if (aes128_gcm_nonce_next(n, iv)) {
+        return -1;
+    }
+    return gcm_seal(n->gcm, NULL, iv, 12, plain, plain_len, aad, aad_len, crypt, tag);
+}
+
+/* As aes128_gcm_encrypt_next(), drawing the IV from a reserved range. */
+int aes128_gcm_encrypt_range(aes128_gcm_nonce_range *r, const uint8_t *plain, size_t plain_len,
+                             const uint8_t *aad, size_t aad_len, uint8_t *crypt, uint8_t iv[12], uint8_t *tag) {
+    if (aes128_gcm_nonce_range_next(r, iv)) {
+        return -1;
+    }
+    return gcm_seal(r->gcm, NULL, iv, 12, plain, plain_len, aad, aad_len, crypt, tag);
+}
+
+/* --- GMAC --- */
+
+/* Blocks each GMAC worker gets at least (64 KiB): below that, starting
+   a thread costs more than the GHASH work it takes over. */
+#define GMAC_MIN_CHUNK 4096
+
+/* Maximum number of GMAC workers, the calling thread included. */
+#define GMAC_MAX_THREADS 64
+
+#ifdef AES_DUST_THREADS
+typedef struct {
+    const aes128_gcm_ctx *c;
+    const uint8_t *x;
+    size_t n;
+    uint8_t y[AES_BLK_LEN];
+} gmac_part;
+
+/* GHASH of one chunk of whole blocks, from zero. */
+static void *gmac_part_run(void *arg) {
+    gmac_part *p = (gmac_part *)arg;
+
+    ghash_start(p->y);
+    aes_ghash_update(&p->c->gf, p->y, p->x, p->n);
+    return NULL;
+}
+
+/* Hash the n whole blocks of x into S, split across up to threads
+ * workers. Each worker hashes its chunk from zero; the partial results
+ * are joined in order as S = S * H^m ^ Y for a chunk of m blocks.
+ */
+static void gmac_blocks(const aes128_gcm_ctx *c, uint8_t *S, const uint8_t *x, size_t n, uint32_t threads) {
+    gmac_part part[GMAC_MAX_THREADS];
+    pthread_t tid[GMAC_MAX_THREADS];
+    int started[GMAC_MAX_THREADS];
+    size_t chunk;
+    uint32_t t;
+
+    if (threads > GMAC_MAX_THREADS) {
+        threads = GMAC_MAX_THREADS;
+    }
+    if (threads > n / GMAC_MIN_CHUNK) {
+        threads = (uint32_t)(n / GMAC_MIN_CHUNK);
+    }
+    if (threads < 2) {
+        aes_ghash_update(&c->gf, S, x, n);
+        return;
+    }
+
+    chunk = (n + threads - 1) / threads;
+    for (t = 0; t < threads; t++) {
+        part[t].c = c;
+        part[t].x = x + t * chunk * AES_BLK_LEN;
+        part[t].n = t + 1 < threads ? chunk : n - t * chunk;
+    }
+
+    /* A worker that cannot be started is run here instead */
+    for (t = 1; t < threads; t++) {
+        started[t] = pthread_create(&tid[t], NULL, gmac_part_run, &part[t]) == 0;
+    }
+    gmac_part_run(&part[0]);
+    for (t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(tid[t], NULL);
+        } else {
+            gmac_part_run(&part[t]);
+        }
+    }
+
+    for (t = 0; t < threads; t++) {
+        aes_ghash_shift(&c->gf, S, part[t].n);
+        for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
+            S[j] ^= part[t].y[j];
+        }
+    }
+}
+#else
+/* Without worker threads the chunks would only run one after another,
+ * each join costing a power of H, so the input is hashed in one go.
+ */
+static void gmac_blocks(const aes128_gcm_ctx *c, uint8_t *S, const uint8_t *x, size_t n, uint32_t threads) {
+    (void)threads;
+    aes_ghash_update(&c->gf, S, x, n);
+}
+#endif
+
+/* GMAC tag over aad (GCM with an empty plaintext), with the GHASH work
+ * split across up to threads workers. Without AES_DUST_THREADS, or for
+ * inputs under about 128 KiB, it all runs on the calling thread; the
+ * tag does not depend on the split.
+ * Returns 0 on success, -1 if aad is too long.
+ */
+int aes128_gmac_parallel(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+                         const uint8_t *aad, size_t aad_len, uint32_t threads, uint8_t *tag) {
+    uint8_t J0[AES_BLK_LEN], S[AES_BLK_LEN];
+    size_t full = aad_len / AES_BLK_LEN;
+
+    if (!gcm_aad_ok(aad_len)) {
+        return -1;
+    }
+    aes_gcm_prepare_j0(c, iv, iv_len, J0);
+    ghash_start(S);
+    if (aad_len) {
+        gmac_blocks(c, S, aad, full, threads);
+        ghash(c, aad + full * AES_BLK_LEN, aad_len & (AES_BLK_LEN - 1), S);
+    }
+    gcm_tag(c, J0, S, aad_len, 0, tag);
+    return 0;
+}
+
+/* GMAC tag over aad on the calling thread.
+ * Returns 0 on success, -1 if aad is too long.
+ */
+int aes128_gmac_ctx(const aes128_gcm_ctx *c, const uint8_t *iv, uint32_t iv_len,
+                    const uint8_t *aad, size_t aad_len, uint8_t *tag) {
+    return aes128_gmac_parallel(c, iv, iv_len, aad, aad_len, 1, tag);
+}
+
+/* GMAC under a raw 16, 24 or 32-byte key.
+ * Returns 0 on success, -1 if key_len is invalid or aad is too long.
+ */
+int aes128_gmac(const uint8_t *key, uint32_t key_len, const uint8_t *iv, uint32_t iv_len,
+                const uint8_t *aad, size_t aad_len, uint8_t *tag) {
+    aes128_gcm_ctx c;
+
+    if (aes128_gcm_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_gmac_ctx(&c, iv, iv_len, aad, aad_len, tag);
+}
+
+/* --- Batched GCM --- */
+
+/* Messages processed together. Their tag masks and short tails share
+   one AES call, and their GHASH chains are stepped together. */
+#define GCM_BATCH_LANES AES_GF_LANES
+
+/* One message of a group. Its payload splits into a head of whole
+   AES_PAR_BLOCKS-block runs, which keep the multi-block kernel full on
+   their own, and a tail of under AES_PAR_BLOCKS * 16 bytes whose
+   keystream is drawn with E(K, J0) in the shared call. */
+typedef struct {
+    aes128_gcm_msg *m;
+    uint8_t s[AES_BLK_LEN];                     /* GHASH accumulator. */
+    uint8_t cb[AES_BLK_LEN];                    /* Counter block of the head. */
+    const uint8_t *ks;                          /* E(K, J0), then the tail keystream. */
+    const uint8_t *x;                           /* GHASH input of the current phase. */
+    size_t head;                                /* Head bytes. */
+    uint32_t nx;                                /* Blocks at x. */
+    uint8_t buf[(AES_PAR_BLOCKS + 1) * AES_BLK_LEN];
+} gcm_lane;
+
+/* Start a lane and lay its J0 and tail counter blocks out at ctr;
+   returns how many, or -1 if the message's lengths are out of range. */
+static int gcm_lane_start(const aes128_gcm_ctx *c, gcm_lane *l, aes128_gcm_msg *m, uint8_t *ctr) {
+    uint32_t nb;
+
+    aes_gcm_prepare_j0(c, m->iv, m->iv_len, ctr);
+    if (!gcm_ctr_ok(m->len, ctr) || !gcm_aad_ok(m->aad_len)) {
+        return -1;
+    }
+    l->m = m;
+    l->head = m->len / (AES_PAR_BLOCKS * AES_BLK_LEN) * (AES_PAR_BLOCKS * AES_BLK_LEN);
+    memcpy(l->cb, ctr, AES_BLK_LEN);
+    inc32(l->cb);
+
+    /* J0, then the tail's counters, which follow the head's */
+    nb = 1 + (uint32_t)((m->len - l->head + AES_BLK_LEN - 1) / AES_BLK_LEN);
+    for (uint32_t i = 1; i < nb; i++) {
+        uint8_t *b = ctr + i * AES_BLK_LEN;
+        memcpy(b, l->cb, AES_BLK_LEN);
+        PUT_BE32(b + 12, GET_BE32(l->cb + 12) + (uint32_t)(l->head / AES_BLK_LEN) + i - 1);
+    }
+    ghash_start(l->s);
+    return (int)nb;
+}
+
+/* Bytes [off, off + 16) of p, which holds len bytes, zero-padded. */
+static void gcm_lane_load(uint8_t *block, const uint8_t *p, size_t off, size_t len) {
+    if (len - off >= AES_BLK_LEN) {
+        memcpy(block, p + off, AES_BLK_LEN);
+    } else {
+        memset(block, 0, AES_BLK_LEN);
+        memcpy(block, p + off, len - off);
+    }
+}
+
+/* out = in ^ ks over len bytes, a word at a time where possible. */
+static void gcm_xor(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t len) {
+    size_t j = 0;
+
+    for (; j + 8 <= len; j += 8) {
+        uint64_t a, b;
+        memcpy(&a, in + j, 8);
+        memcpy(&b, ks + j, 8);
+        a ^= b;
+        memcpy(out + j, &a, 8);
+    }
+    for (; j < len; j++) {
+        out[j] = in[j] ^ ks[j];
+    }
+}
+
+/* Step the GHASH chains of all n lanes over their x[0 .. nx). */
+static void gcm_lanes_ghash(const aes128_gcm_ctx *c, gcm_lane *lane, uint32_t n) {
+    uint8_t *y[GCM_BATCH_LANES];
+    const uint8_t *x[GCM_BATCH_LANES];
+    uint32_t nx[GCM_BATCH_LANES];
+
+    for (uint32_t i = 0; i < n; i++) {
+        y[i] = lane[i].s;
+        x[i] = lane[i].x;
+        nx[i] = lane[i].nx;
+    }
+    aes_ghash_update_lanes(&c->gf, y, x, nx, n);
+}
+
+/* Crypt the lane's tail with its keystream and lay out the tail and
+   the length block as its GHASH input. Encryption hashes a block after
+   writing it and decryption before, so in-place output never
+   overwrites unhashed ciphertext. */
+static void gcm_lane_tail(gcm_lane *l, int enc) {
+    const aes128_gcm_msg *m = l->m;
+    uint32_t i = 0;
+
+    for (size_t off = l->head; off < m->len; off += AES_BLK_LEN, i++) {
+        size_t n = m->len - off < AES_BLK_LEN ? m->len - off : AES_BLK_LEN;
+        uint8_t *x = l->buf + i * AES_BLK_LEN;
+
+        if (!enc) {
+            gcm_lane_load(x, m->in, off, m->len);
+        }
+        gcm_xor(m->out + off, m->in + off, l->ks + (i + 1) * AES_BLK_LEN, n);
+        if (enc) {
+            gcm_lane_load(x, m->out, off, m->len);
+        }
+    }
+    PUT_BE64(l->buf + i * AES_BLK_LEN, (uint64_t)m->aad_len * 8);
+    PUT_BE64(l->buf + i * AES_BLK_LEN + 8, (uint64_t)m->len * 8);
+    l->x = l->buf;
+    l->nx = i + 1;
+}
+
+/* Finish a lane's message: tag it, or check its tag. */
+static int gcm_lane_finish(const gcm_lane *l, int enc) {
+    aes128_gcm_msg *m = l->m;
+    uint8_t T[AES_BLK_LEN];
+
+    xor16(T, l->s, l->ks);
+    if (enc) {
+        memcpy(m->tag, T, AES_BLK_LEN);
+        return 0;
+    }
+    if (!ct_eq16(m->tag, T)) {
+        if (m->len) {
+            memset(m->out, 0, m->len);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/* Seal or open n messages, GCM_BATCH_LANES at a time. The tag masks
+ * and tails of a group go through one multi-block AES call, so short
+ * messages keep the AES pipeline full together, and the group's GHASH
+ * chains over AAD and tails advance in lock-step.
+ */
+static int gcm_batch(const aes128_gcm_ctx *c, aes128_gcm_msg *msgs, size_t n, int enc) {
+    gcm_lane lane[GCM_BATCH_LANES];
+    uint8_t ks[GCM_BATCH_LANES * (AES_PAR_BLOCKS + 1) * AES_BLK_LEN];
+    size_t next = 0;
+    int rc = 0;
+
+    while (next < n) {
+        uint32_t active = 0, nb = 0;
+
+        /* Gather the next valid messages and their counter blocks */
+        while (active < GCM_BATCH_LANES && next < n) {
+            aes128_gcm_msg *m = &msgs[next++];
+            gcm_lane *l = &lane[active];
+            int used = gcm_lane_start(c, l, m, ks + nb * AES_BLK_LEN);
+
+            if (used < 0) {
+                m->status = -1;
+                rc = -1;
+                continue;
+            }
+            l->ks = ks + nb * AES_BLK_LEN;
+            nb += (uint32_t)used;
+            active++;
+        }
+        if (active == 0) {
+            break;
+        }
+
+        aes128_key_encrypt_blocks(&c->key, ks, ks, nb);
+
+        /* AAD: the whole blocks in place, then any padded last block */
+        for (uint32_t i = 0; i < active; i++) {
+            lane[i].x = lane[i].m->aad;
+            lane[i].nx = (uint32_t)(lane[i].m->aad_len / AES_BLK_LEN);
+        }
+        gcm_lanes_ghash(c, lane, active);
+        for (uint32_t i = 0; i < active; i++) {
+            gcm_lane *l = &lane[i];
+            size_t full = l->m->aad_len & ~(size_t)(AES_BLK_LEN - 1);
+
+            l->nx = full < l->m->aad_len;
+            if (l->nx) {
+                gcm_lane_load(l->buf, l->m->aad, full, l->m->aad_len);
+            }
+            l->x = l->buf;
+        }
+        gcm_lanes_ghash(c, lane, active);
+
+        /* Heads, each on its own, then the tails and length blocks */
+        for (uint32_t i = 0; i < active; i++) {
+            gcm_lane *l = &lane[i];
+
+            gcm_crypt_blocks(c, l->cb, l->s, l->m->in, l->m->out, l->head / AES_BLK_LEN, enc);
+            gcm_lane_tail(l, enc);
+        }
+        gcm_lanes_ghash(c, lane, active);
+
+        for (uint32_t i = 0; i < active; i++) {
+            lane[i].m->status = gcm_lane_finish(&lane[i], enc);
+            rc |= lane[i].m->status;
+        }
+    }
+    return rc;
+}
+
+/* Encrypt n independent messages under one keyed context, for traffic
+ * made of many short packets. Each descriptor's status is set, and its
+ * tag written, exactly as aes128_gcm_encrypt_ctx() would.
+ * Returns 0 if every message succeeded, -1 otherwise.
+ */
+int aes128_gcm_encrypt_batch(const aes128_gcm_ctx *c, aes128_gcm_msg *msgs, size_t n) {
+    return gcm_batch(c, msgs, n, 1);
+}
+
+/* Decrypt and verify n independent messages under one keyed context.
+ * A message that fails authentication gets status -1 and a zeroed
+ * output buffer; the others are unaffected.
+ * Returns 0 if every message is authentic, -1 otherwise.
+ */
+int aes128_gcm_decrypt_batch(const aes128_gcm_ctx *c, aes128_gcm_msg *msgs, size_t n) {
+    return gcm_batch(c, msgs, n, 0);
+}
+
+/* --- Streaming GCM --- */
+
+/* Absorb len bytes of AAD or ciphertext into the GHASH accumulator,
+ * holding back any partial block until more data or a flush arrives.
+ */
+static void gcm_stream_absorb(aes128_gcm_stream *s, const uint8_t *x, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (s->buf_len) {
+        uint32_t n = AES_BLK_LEN - s->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s->buf + s->buf_len, x, n);
+        s->buf_len += n;
+        x += n;
+        len -= n;
+        if (s->buf_len < AES_BLK_LEN) {
+            return;
+        }
+        aes_ghash_update(&s->gcm->gf, s->s, s->buf, 1);
+        s->buf_len = 0;
+    }
+
+    aes_ghash_update(&s->gcm->gf, s->s, x, len / AES_BLK_LEN);
+    x += len & ~(size_t)(AES_BLK_LEN - 1);
+    len &= AES_BLK_LEN - 1;
+    memcpy(s->buf, x, len);
+    s->buf_len = len;
+}
+
+/* Zero-pad and hash a pending partial block. */
+static void gcm_stream_flush(aes128_gcm_stream *s) {
+    if (s->buf_len) {
+        memset(s->buf + s->buf_len, 0, AES_BLK_LEN - s->buf_len);
+        aes_ghash_update(&s->gcm->gf, s->s, s->buf, 1);
+        s->buf_len = 0;
+    }
+}
+
+/* Encrypt or decrypt len bytes and hash the ciphertext, continuing any
+ * partial block left by the previous call.
+ */
+static void gcm_stream_crypt(aes128_gcm_stream *s, const uint8_t *in, uint8_t *out, size_t len, int enc) {
+    uint32_t off = (uint32_t)s->len & (AES_BLK_LEN - 1);
+    size_t n, full;
+
+    s->len += len;
+
+    /* Rest of the keystream block left over from the last call */
+    if (off) {
+        n = AES_BLK_LEN - off;
+        if (n > len) {
+            n = len;
+        }
+        if (!enc) {
+            gcm_stream_absorb(s, in, n);
+        }
+        for (size_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ s->ks[off + i];
+        }
+        if (enc) {
+            gcm_stream_absorb(s, out, n);
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    /* Whole blocks go through the single-pass kernel; the GHASH buffer
+       is empty here since it tracks the message offset. */
+    full = len / AES_BLK_LEN;
+    gcm_crypt_blocks(s->gcm, s->ctr, s->s, in, out, full, enc);
+    in += full * AES_BLK_LEN;
+    out += full * AES_BLK_LEN;
+    len -= full * AES_BLK_LEN;
+
+    if (len) {
+        memcpy(s->ks, s->ctr, AES_BLK_LEN);
+        aes128_key_encrypt(&s->gcm->key, s->ks);
+        inc32(s->ctr);
+        if (!enc) {
+            gcm_stream_absorb(s, in, len);
+        }
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ s->ks[i];
+        }
+        if (enc) {
+            gcm_stream_absorb(s, out, len);
+        }
+    }
+}
+
+/* Start AAD or data; returns 0 if the stream is in a state that allows it. */
+static int gcm_stream_enter(aes128_gcm_stream *s, int state, size_t len) {
+    if (s->state > state) {
         return -1;
     }
+    if (state == AES128_GCM_STREAM_DATA) {
+        if (!gcm_ctr_ok(s->len + len, s->j0)) {
+            return -1;
+        }
+        if (s->state == AES128_GCM_STREAM_AAD) {
+            gcm_stream_flush(s);
+        }
+    }
+    s->state = state;
+    return 0;
+}
+
+/* Begin a message under the keyed context c and the given IV.
+ * c must stay valid, and unchanged, until the stream is finished.
+ * Returns 0 on success.
+ */
+int aes128_gcm_stream_init(aes128_gcm_stream *s, const aes128_gcm_ctx *c,
+                           const uint8_t *iv, uint32_t iv_len) {
+    s->gcm = c;
+    aes_gcm_prepare_j0(c, iv, iv_len, s->j0);
+    memcpy(s->ctr, s->j0, AES_BLK_LEN);
+    inc32(s->ctr);
+    ghash_start(s->s);
+    s->aad_len = 0;
+    s->len = 0;
+    s->buf_len = 0;
+    s->state = AES128_GCM_STREAM_AAD;
+    return 0;
+}
+
+/* Add len bytes of additional authenticated data. All AAD must be
+ * supplied before the first encrypt or decrypt call.
+ * Returns 0 on success, -1 if data has already been processed or the
+ * AAD would exceed the GCM limit.
+ */
+int aes128_gcm_stream_aad(aes128_gcm_stream *s, const uint8_t *aad, size_t len) {
+    if (gcm_stream_enter(s, AES128_GCM_STREAM_AAD, 0) || !gcm_aad_more_ok(s->aad_len, len)) {
+        return -1;
+    }
+    s->aad_len += len;
+    gcm_stream_absorb(s, aad, len);
+    return 0;
+}
 
-    aes_gcm_gctr(&ctx, J0, crypt, crypt_len, plain);
+/* Start the AAD from a prefix midstate, in place of hashing the prefix
+ * with aes128_gcm_stream_aad(). Must come before any other AAD; more
+ * may follow. p must come from aes128_gcm_prefix_init() with the
+ * stream's context.
+ * Returns 0 on success, -1 if AAD or data has already been supplied.
+ */
+int aes128_gcm_stream_prefix(aes128_gcm_stream *s, const aes128_gcm_prefix *p) {
+    if (s->state != AES128_GCM_STREAM_AAD || s->aad_len) {
+        return -1;
+    }
+    memcpy(s->s, p->s, AES_BLK_LEN);
+    s->aad_len = p->len;
     return 0;
 }
+
+/* Encrypt the next len bytes of the message; chunks may be any size.
+ * Returns 0 on success, -1 if the stream is finished or the message
+ * would exhaust the 32-bit block counter.
+ */
+int aes128_gcm_stream_encrypt(aes128_gcm_stream *s, const uint8_t *plain, uint8_t *crypt, size_t len) {
+    if (gcm_stream_enter(s, AES128_GCM_STREAM_DATA, len)) {
+        return -1;
+    }
+    gcm_stream_crypt(s, plain, crypt, len, 1);
+    return 0;
+}
+
+/* Decrypt the next len bytes of the message. The plaintext is released
+ * before the tag is checked: callers must not act on it until
+ * aes128_gcm_stream_verify() succeeds.
+ * Returns 0 on success, -1 as for aes128_gcm_stream_encrypt().
+ */
+int aes128_gcm_stream_decrypt(aes128_gcm_stream *s, const uint8_t *crypt, uint8_t *plain, size_t len) {
+    if (gcm_stream_enter(s, AES128_GCM_STREAM_DATA, len)) {
+        return -1;
+    }
+    gcm_stream_crypt(s, crypt, plain, len, 0);
+    return 0;
+}
+
+/* Finish an encryption and write the 16-byte tag.
+ * Returns 0 on success, -1 if the stream was already finished.
+ */
+int aes128_gcm_stream_final(aes128_gcm_stream *s, uint8_t *tag) {
+    if (s->state == AES128_GCM_STREAM_DONE) {
+        return -1;
+    }
+    gcm_stream_flush(s);
+    gcm_tag(s->gcm, s->j0, s->s, s->aad_len, s->len, tag);
+    s->state = AES128_GCM_STREAM_DONE;
+    return 0;
+}
+
+/* Finish a decryption and check the 16-byte tag in constant time.
+ * Returns 0 if the message is authentic, -1 otherwise.
+ */
+int aes128_gcm_stream_verify(aes128_gcm_stream *s, const uint8_t *tag) {
+    uint8_t T[AES_BLK_LEN];
+
+    if (aes128_gcm_stream_final(s, T)) {
+        return -1;
+    }
+    return ct_eq16(tag, T) ? 0 : -1;
+}
@@ -27,18 +27,16 @@
 
 #include <aes128_gcm_siv.h>
 #include <string.h>
+#include "aes128_impl.h"
 
-static void xor_block(uint8_t *dst, const uint8_t *src) {
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        dst[i] ^= src[i];
-    }
-}
+/* Plaintext and AAD are each limited to 2^36 bytes (RFC 8452, section 6). */
+#define GCM_SIV_MAX_LEN ((uint64_t)1 << 36)
 
-static int gcm_siv_ctr_ok(uint32_t len, const uint8_t tag[AES_BLK_LEN]) {
+static int gcm_siv_ctr_ok(uint64_t len, const uint8_t tag[AES_BLK_LEN]) {
     if (len == 0) {
         return 1;
     }
-    uint64_t blocks = ((uint64_t)len + AES_BLK_LEN - 1) / AES_BLK_LEN;
+    uint64_t blocks = (len + AES_BLK_LEN - 1) / AES_BLK_LEN;
     uint32_t ctr = (uint32_t)tag[0] |
                    ((uint32_t)tag[1] << 8) |
                    ((uint32_t)tag[2] << 16) |
@@ -47,55 +45,18 @@ static int gcm_siv_ctr_ok(uint32_t len, const uint8_t tag[AES_BLK_LEN]) {
     return blocks <= remaining;
 }
 
-static void polyval_mul(const uint8_t *x, const uint8_t *y, uint8_t *out) {
-    uint8_t z[AES_BLK_LEN] = {0};
-    uint8_t v[AES_BLK_LEN];
-    memcpy(v, y, AES_BLK_LEN);
-
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        for (uint32_t bit = 0; bit < 8; bit++) {
-            if (x[i] & (1U << bit)) {
-                xor_block(z, v);
-            }
-
-            uint8_t carry = 0;
-            for (uint32_t j = 0; j < AES_BLK_LEN; j++) {
-                uint8_t next = (uint8_t)((v[j] >> 7) & 1U);
-                v[j] = (uint8_t)((v[j] << 1) | carry);
-                carry = next;
-            }
-            if (carry) {
-                v[0] ^= 0x01;
-                v[AES_BLK_LEN - 1] ^= 0xC2;
-            }
-        }
-    }
-
-    memcpy(out, z, AES_BLK_LEN);
-}
-
-static void polyval_update(uint8_t y[AES_BLK_LEN], const uint8_t h[AES_BLK_LEN],
-                           const uint8_t *data, uint32_t len) {
+/* Absorbs len bytes, zero-padding the last partial block. */
+static void polyval_update(uint8_t y[AES_BLK_LEN], const aes128_gf_key *gf,
+                           const uint8_t *data, size_t len) {
     uint8_t block[AES_BLK_LEN];
-    uint8_t tmp[AES_BLK_LEN];
-
-    while (len >= AES_BLK_LEN) {
-        memcpy(block, data, AES_BLK_LEN);
-        for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-            tmp[i] = (uint8_t)(y[i] ^ block[i]);
-        }
-        polyval_mul(tmp, h, y);
-        data += AES_BLK_LEN;
-        len -= AES_BLK_LEN;
-    }
+    size_t m = len / AES_BLK_LEN;
 
+    aes_polyval_update(gf, y, data, m);
+    len -= m * AES_BLK_LEN;
     if (len) {
         memset(block, 0, AES_BLK_LEN);
-        memcpy(block, data, len);
-        for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-            tmp[i] = (uint8_t)(y[i] ^ block[i]);
-        }
-        polyval_mul(tmp, h, y);
+        memcpy(block, data + m * AES_BLK_LEN, len);
+        aes_polyval_update(gf, y, block, 1);
     }
 }
 
@@ -106,81 +67,76 @@ static void write_le64(uint8_t out[8], uint64_t v) {
     }
 }
 
+static size_t gcm_siv_blocks(size_t len) {
+    return (len + AES_BLK_LEN - 1) / AES_BLK_LEN;
+}
+
 static void polyval_hash(uint8_t out[AES_BLK_LEN], const uint8_t h[AES_BLK_LEN],
-                         const uint8_t *aad, uint32_t aad_len,
-                         const uint8_t *plain, uint32_t plain_len) {
-    static const uint8_t polyval_x_inv[AES_BLK_LEN] = {
-        0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-        0x00,0x00,0x00,0x00,0x00,0x00,0x04,0x92
-    };
-    uint8_t y[AES_BLK_LEN] = {0};
-    uint8_t h_dot[AES_BLK_LEN];
+                         const uint8_t *aad, size_t aad_len,
+                         const uint8_t *plain, size_t plain_len) {
+    aes128_gf_key gf;
     uint8_t len_block[AES_BLK_LEN];
-    uint8_t tmp[AES_BLK_LEN];
-
-    /* POLYVAL uses dot(a, b) = a * b * x^-128. Precompute H * x^-128. */
-    polyval_mul(h, polyval_x_inv, h_dot);
+    size_t na = gcm_siv_blocks(aad_len), np = gcm_siv_blocks(plain_len);
 
-    polyval_update(y, h_dot, aad, aad_len);
-    polyval_update(y, h_dot, plain, plain_len);
+    /* h is new for every nonce: compute only the powers used */
+    aes_polyval_init(&gf, h, na > np ? na : np);
+    memset(out, 0, AES_BLK_LEN);
+    polyval_update(out, &gf, aad, aad_len);
+    polyval_update(out, &gf, plain, plain_len);
 
     write_le64(len_block, (uint64_t)aad_len * 8);
     write_le64(len_block + 8, (uint64_t)plain_len * 8);
-
-    for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-        tmp[i] = (uint8_t)(y[i] ^ len_block[i]);
-    }
-    polyval_mul(tmp, h_dot, y);
-    memcpy(out, y, AES_BLK_LEN);
+    aes_polyval_update(&gf, out, len_block, 1);
 }
 
-static void gcm_siv_derive(const uint8_t *key, const uint8_t *nonce,
-                           uint8_t h[AES_BLK_LEN], uint8_t k[AES_BLK_LEN],
-                           aes128_ctx *ctx) {
-    uint8_t block[AES_BLK_LEN];
+/* Derives the POLYVAL key h and the message-encryption key from the
+   key-generating key (RFC 8452 section 4). The four or six derivation
+   blocks go through one multi-block call. */
+static void gcm_siv_derive(const aes128_gcm_siv_ctx *c, const uint8_t *nonce,
+                           uint8_t h[AES_BLK_LEN], aes128_key *k) {
+    uint8_t blocks[6 * AES_BLK_LEN], mk[AES_MAX_KEY_LEN];
+    uint32_t n = 2 + c->key_len / 8;
+
+    for (uint32_t i = 0; i < n; i++) {
+        unpack32(i, blocks + i * AES_BLK_LEN);
+        memcpy(blocks + i * AES_BLK_LEN + 4, nonce, 12);
+    }
+    aes128_key_encrypt_blocks(&c->key, blocks, blocks, n);
 
-    aes128_init_ctx(ctx);
-    aes128_set_key(ctx, key);
-
-    for (uint32_t i = 0; i < 4; i++) {
-        block[0] = (uint8_t)(i & 0xFF);
-        block[1] = (uint8_t)((i >> 8) & 0xFF);
-        block[2] = (uint8_t)((i >> 16) & 0xFF);
-        block[3] = (uint8_t)((i >> 24) & 0xFF);
-        memcpy(block + 4, nonce, 12);
-        aes128_ecb_encrypt(ctx, block);
-
-        if (i == 0) {
-            memcpy(h, block, 8);
-        } else if (i == 1) {
-            memcpy(h + 8, block, 8);
-        } else if (i == 2) {
-            memcpy(k, block, 8);
+    for (uint32_t i = 0; i < n; i++) {
+        if (i < 2) {
+            memcpy(h + 8 * i, blocks + i * AES_BLK_LEN, 8);
         } else {
-            memcpy(k + 8, block, 8);
+            memcpy(mk + 8 * (i - 2), blocks + i * AES_BLK_LEN, 8);
         }
     }
+    aes128_key_expand_len(k, mk, c->key_len);
 }
 
-static void gcm_siv_ctr(aes128_ctx *ctx, const uint8_t tag[AES_BLK_LEN],
-                        const uint8_t *in, uint8_t *out, uint32_t len) {
+/* CTR with the tag as initial counter (top bit set) and a 32-bit
+   little-endian counter in its first word, AES_PAR_BLOCKS at a time. */
+static void gcm_siv_ctr(const aes128_key *k, const uint8_t tag[AES_BLK_LEN],
+                        const uint8_t *in, uint8_t *out, size_t len) {
+    uint8_t stream[AES_PAR_BLOCKS * AES_BLK_LEN];
     uint8_t ctr[AES_BLK_LEN];
-    uint8_t stream[AES_BLK_LEN];
+    uint32_t c0;
+
     memcpy(ctr, tag, AES_BLK_LEN);
     ctr[AES_BLK_LEN - 1] |= 0x80;
+    c0 = pack32(ctr);
 
     while (len) {
-        memcpy(stream, ctr, AES_BLK_LEN);
-        aes128_ecb_encrypt(ctx, stream);
+        uint32_t nb = (uint32_t)(len < AES_PAR_BLOCKS * AES_BLK_LEN ?
+                                 gcm_siv_blocks(len) : AES_PAR_BLOCKS);
+        size_t n = len < nb * AES_BLK_LEN ? len : nb * AES_BLK_LEN;
 
-        uint32_t n = len > AES_BLK_LEN ? AES_BLK_LEN : len;
-        for (uint32_t i = 0; i < n; i++) {
-            out[i] = (uint8_t)(in[i] ^ stream[i]);
+        for (uint32_t j = 0; j < nb; j++) {
+            unpack32(c0++, ctr);
+            memcpy(stream + j * AES_BLK_LEN, ctr, AES_BLK_LEN);
         }
-
-        for (uint32_t i = 0; i < 4; i++) {
-            ctr[i]++;
-            if (ctr[i] != 0) break;
+        aes128_key_encrypt_blocks(k, stream, stream, nb);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = (uint8_t)(in[i] ^ stream[i]);
         }
 
         in += n;
@@ -196,71 +152,90 @@ static int ct_eq16(const uint8_t a[16], const uint8_t b[16]) {
     return 1 ^ (int)d;
 }
 
-int aes128_gcm_siv_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                           const uint8_t *aad, uint32_t aad_len, const uint8_t *plain, uint32_t plain_len,
-                           uint8_t *crypt, uint8_t *tag) {
-    if (key_len != AES_KEY_LEN || nonce_len != 12) {
-        return -1;
+/* Tag = AES-K(POLYVAL(h, A, P) ^ nonce, top bit cleared). */
+static void gcm_siv_tag(const aes128_key *k, const uint8_t h[AES_BLK_LEN], const uint8_t *nonce,
+                        const uint8_t *aad, size_t aad_len, const uint8_t *plain, size_t plain_len,
+                        uint8_t tag[AES_BLK_LEN]) {
+    polyval_hash(tag, h, aad, aad_len, plain, plain_len);
+    for (uint32_t i = 0; i < 12; i++) {
+        tag[i] ^= nonce[i];
     }
+    tag[AES_BLK_LEN - 1] &= 0x7F;
+    aes128_key_encrypt(k, tag);
+}
 
-    aes128_ctx ctx;
-    uint8_t h[AES_BLK_LEN];
-    uint8_t k[AES_BLK_LEN];
-    uint8_t s[AES_BLK_LEN];
-
-    gcm_siv_derive(key, nonce, h, k, &ctx);
-    aes128_set_key(&ctx, k);
+/* Set up a GCM-SIV context for a 16 or 32-byte key-generating key.
+ * Its key schedule is kept; only the per-nonce keys are derived per
+ * message.
+ * Returns 0 on success, -1 if key_len is invalid.
+ */
+int aes128_gcm_siv_init(aes128_gcm_siv_ctx *c, const uint8_t *key, uint32_t key_len) {
+    if (key_len != 16 && key_len != 32) {
+        return -1;
+    }
+    aes128_key_expand_len(&c->key, key, key_len);
+    c->key_len = key_len;
+    return 0;
+}
 
-    polyval_hash(s, h, aad, aad_len, plain, plain_len);
-    for (uint32_t i = 0; i < 12; i++) {
-        s[i] ^= nonce[i];
+/* GCM-SIV encryption under a context set up by aes128_gcm_siv_init().
+ * Arguments and result are those of aes128_gcm_siv_encrypt() without
+ * the key.
+ */
+int aes128_gcm_siv_encrypt_ctx(const aes128_gcm_siv_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                               const uint8_t *aad, size_t aad_len, const uint8_t *plain, size_t plain_len,
+                               uint8_t *crypt, uint8_t *tag) {
+    if (nonce_len != 12) {
+        return -1;
+    }
+    if ((uint64_t)aad_len > GCM_SIV_MAX_LEN || (uint64_t)plain_len > GCM_SIV_MAX_LEN) {
+        return -1;
     }
-    s[AES_BLK_LEN - 1] &= 0x7F;
 
-    memcpy(tag, s, AES_BLK_LEN);
-    aes128_ecb_encrypt(&ctx, tag);
+    aes128_key k;
+    uint8_t h[AES_BLK_LEN];
+
+    gcm_siv_derive(c, nonce, h, &k);
+    gcm_siv_tag(&k, h, nonce, aad, aad_len, plain, plain_len, tag);
 
     if (plain_len) {
         if (!gcm_siv_ctr_ok(plain_len, tag)) {
             return -1;
         }
-        gcm_siv_ctr(&ctx, tag, plain, crypt, plain_len);
+        gcm_siv_ctr(&k, tag, plain, crypt, plain_len);
     }
 
     return 0;
 }
 
-int aes128_gcm_siv_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
-                           const uint8_t *aad, uint32_t aad_len, const uint8_t *crypt, uint32_t crypt_len,
-                           const uint8_t *tag, uint8_t *plain) {
-    if (key_len != AES_KEY_LEN || nonce_len != 12) {
+/* GCM-SIV decryption under a context set up by aes128_gcm_siv_init().
+ * Arguments and result are those of aes128_gcm_siv_decrypt() without
+ * the key.
+ */
+int aes128_gcm_siv_decrypt_ctx(const aes128_gcm_siv_ctx *c, const uint8_t *nonce, uint32_t nonce_len,
+                               const uint8_t *aad, size_t aad_len, const uint8_t *crypt, size_t crypt_len,
+                               const uint8_t *tag, uint8_t *plain) {
+    if (nonce_len != 12) {
+        return -1;
+    }
+    if ((uint64_t)aad_len > GCM_SIV_MAX_LEN || (uint64_t)crypt_len > GCM_SIV_MAX_LEN) {
         return -1;
     }
 
-    aes128_ctx ctx;
+    aes128_key k;
     uint8_t h[AES_BLK_LEN];
-    uint8_t k[AES_BLK_LEN];
-    uint8_t s[AES_BLK_LEN];
     uint8_t calc[AES_BLK_LEN];
 
-    gcm_siv_derive(key, nonce, h, k, &ctx);
-    aes128_set_key(&ctx, k);
+    gcm_siv_derive(c, nonce, h, &k);
 
     if (crypt_len) {
         if (!gcm_siv_ctr_ok(crypt_len, tag)) {
             return -1;
         }
-        gcm_siv_ctr(&ctx, tag, crypt, plain, crypt_len);
+        gcm_siv_ctr(&k, tag, crypt, plain, crypt_len);
     }
 
-    polyval_hash(s, h, aad, aad_len, plain, crypt_len);
-    for (uint32_t i = 0; i < 12; i++) {
-        s[i] ^= nonce[i];
-    }
-    s[AES_BLK_LEN - 1] &= 0x7F;
-
-    memcpy(calc, s, AES_BLK_LEN);
-    aes128_ecb_encrypt(&ctx, calc);
+    gcm_siv_tag(&k, h, nonce, aad, aad_len, plain, crypt_len, calc);
 
     if (!ct_eq16(tag, calc)) {
         if (crypt_len) {
@@ -271,3 +246,25 @@ int aes128_gcm_siv_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *
 
     return 0;
 }
+
+int aes128_gcm_siv_encrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, size_t aad_len, const uint8_t *plain, size_t plain_len,
+                           uint8_t *crypt, uint8_t *tag) {
+    aes128_gcm_siv_ctx c;
+
+    if (aes128_gcm_siv_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_gcm_siv_encrypt_ctx(&c, nonce, nonce_len, aad, aad_len, plain, plain_len, crypt, tag);
+}
+
+int aes128_gcm_siv_decrypt(const uint8_t *key, uint32_t key_len, const uint8_t *nonce, uint32_t nonce_len,
+                           const uint8_t *aad, size_t aad_len, const uint8_t *crypt, size_t crypt_len,
+                           const uint8_t *tag, uint8_t *plain) {
+    aes128_gcm_siv_ctx c;
+
+    if (aes128_gcm_siv_init(&c, key, key_len)) {
+        return -1;
+    }
+    return aes128_gcm_siv_decrypt_ctx(&c, nonce, nonce_len, aad, aad_len, crypt, crypt_len, tag, plain);
+}
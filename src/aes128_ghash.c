@@ -0,0 +1,273 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+/*
+ * GF(2^128) multiplication shared by GHASH (GCM) and POLYVAL (GCM-SIV).
+ *
+ * Everything is done in POLYVAL's field: a 128-bit value is two 64-bit
+ * words, low word first, and bit i is the coefficient of x^i. The
+ * product is dot(a, b) = a * b * x^-128 mod x^128 + x^127 + x^126 +
+ * x^121 + 1, whose Montgomery-style reduction needs only shifts. GHASH
+ * maps onto it by byte-reversing every block and using
+ * mulX_POLYVAL(ByteReverse(H)) as the key (RFC 8452, Appendix A).
+ */
+
+static inline uint64_t get_le64(const uint8_t *p) {
+    return (uint64_t)pack32(p) | ((uint64_t)pack32(p + 4) << 32);
+}
+
+static inline uint64_t get_be64(const uint8_t *p) {
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+           ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+           ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] << 8)  | ((uint64_t)p[7]);
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v) {
+    unpack32((uint32_t)v, p);
+    unpack32((uint32_t)(v >> 32), p + 4);
+}
+
+static inline void put_be64(uint8_t *p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/* Low 64 bits of the carry-less product of x and y. Integer multiplies
+   on operands with holes every fourth bit keep carries out of the bits
+   that are kept, so there are no secret-dependent branches or loads
+   (BearSSL's ctmul64 technique). */
+static uint64_t bmul64(uint64_t x, uint64_t y) {
+    uint64_t x0 = x & 0x1111111111111111ULL, y0 = y & 0x1111111111111111ULL;
+    uint64_t x1 = x & 0x2222222222222222ULL, y1 = y & 0x2222222222222222ULL;
+    uint64_t x2 = x & 0x4444444444444444ULL, y2 = y & 0x4444444444444444ULL;
+    uint64_t x3 = x & 0x8888888888888888ULL, y3 = y & 0x8888888888888888ULL;
+    uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+
+    return (z0 & 0x1111111111111111ULL) | (z1 & 0x2222222222222222ULL) |
+           (z2 & 0x4444444444444444ULL) | (z3 & 0x8888888888888888ULL);
+}
+
+static inline uint64_t rev64(uint64_t x) {
+    x = ((x & 0x5555555555555555ULL) << 1) | ((x >> 1) & 0x5555555555555555ULL);
+    x = ((x & 0x3333333333333333ULL) << 2) | ((x >> 2) & 0x3333333333333333ULL);
+    x = ((x & 0x0f0f0f0f0f0f0f0fULL) << 4) | ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL);
+    x = ((x & 0x00ff00ff00ff00ffULL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+    x = ((x & 0x0000ffff0000ffffULL) << 16) | ((x >> 16) & 0x0000ffff0000ffffULL);
+    return (x << 32) | (x >> 32);
+}
+
+/* z = dot(a, b); z may alias a or b. Karatsuba needs three 64x64
+   products, each taken as a low half and a bit-reversed high half. */
+static void gf_dot(uint64_t z[2], const uint64_t a[2], const uint64_t b[2]) {
+    uint64_t a0 = a[0], a1 = a[1], a2 = a0 ^ a1;
+    uint64_t b0 = b[0], b1 = b[1], b2 = b0 ^ b1;
+    uint64_t z0, z1, z2, z0h, z1h, z2h, v0, v1, v2, v3;
+
+    z0 = bmul64(a0, b0);
+    z1 = bmul64(a1, b1);
+    z2 = bmul64(a2, b2);
+    z0h = rev64(bmul64(rev64(a0), rev64(b0))) >> 1;
+    z1h = rev64(bmul64(rev64(a1), rev64(b1))) >> 1;
+    z2h = rev64(bmul64(rev64(a2), rev64(b2))) >> 1;
+    z2 ^= z0 ^ z1;
+    z2h ^= z0h ^ z1h;
+
+    v0 = z0;
+    v1 = z0h ^ z2;
+    v2 = z1 ^ z2h;
+    v3 = z1h;
+
+    /* Fold the low two words into the high two, one word at a time:
+       w * x^-64 = w * (x^63 + x^62 + x^57) / x^64 + w */
+    v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+    v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+    v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+    v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+    z[0] = v2;
+    z[1] = v3;
+}
+
+/* Pick the engine and, for PCLMULQDQ, fill in H^2 .. H^powers from
+   h[0]. The portable multiplier only ever uses h[0]. */
+static void gf_init(aes128_gf_key *k, size_t powers) {
+    k->impl = AES_GF_SOFT;
+#ifdef AES_DUST_CLMUL
+    if (aes_cpu_has(AES_CPU_PCLMUL | AES_CPU_SSSE3)) {
+        k->impl = AES_GF_CLMUL;
+        for (size_t i = 1; i < powers; i++) {
+            gf_dot(k->h[i], k->h[i - 1], k->h[0]);
+        }
+    }
+#else
+    (void)powers;
+#endif
+}
+
+/* y = (y ^ X1) * H ... for n blocks; be selects GHASH's byte order. */
+static void gf_update(const aes128_gf_key *k, uint64_t y[2], const uint8_t *x, size_t n, int be) {
+#ifdef AES_DUST_CLMUL
+    if (k->impl == AES_GF_CLMUL) {
+        aes_clmul_update(k, y, x, n, be);
+        return;
+    }
+#endif
+    for (; n; n--, x += AES_BLK_LEN) {
+        if (be) {
+            y[0] ^= get_be64(x + 8);
+            y[1] ^= get_be64(x);
+        } else {
+            y[0] ^= get_le64(x);
+            y[1] ^= get_le64(x + 8);
+        }
+        gf_dot(y, y, k->h[0]);
+    }
+}
+
+/**
+ * Sets up k for POLYVAL under the 16-byte key h, for hashing at most
+ * n blocks per update call. Only the powers of h that such calls use
+ * are computed, which matters when the key changes with every message.
+ */
+void aes_polyval_init(aes128_gf_key *k, const uint8_t *h, size_t n) {
+    k->h[0][0] = get_le64(h);
+    k->h[0][1] = get_le64(h + 8);
+    gf_init(k, n < 1 ? 1 : n > AES_GF_POWERS ? AES_GF_POWERS : n);
+}
+
+/**
+ * Absorbs n full blocks into the POLYVAL accumulator y.
+ */
+void aes_polyval_update(const aes128_gf_key *k, uint8_t *y, const uint8_t *x, size_t n) {
+    uint64_t acc[2] = { get_le64(y), get_le64(y + 8) };
+
+    gf_update(k, acc, x, n, 0);
+    put_le64(y, acc[0]);
+    put_le64(y + 8, acc[1]);
+}
+
+/**
+ * Sets up k for GHASH under the hash subkey h = E(K, 0^128).
+ */
+void aes_ghash_init(aes128_gf_key *k, const uint8_t *h) {
+    uint64_t lo = get_be64(h + 8), hi = get_be64(h);
+    uint64_t carry = hi >> 63;
+
+    /* mulX_POLYVAL(ByteReverse(H)) */
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ carry;
+    hi ^= (0 - carry) & 0xc200000000000000ULL;
+    k->h[0][0] = lo;
+    k->h[0][1] = hi;
+    gf_init(k, AES_GF_POWERS);
+}
+
+/**
+ * Absorbs n full blocks into the GHASH accumulator y.
+ */
+void aes_ghash_update(const aes128_gf_key *k, uint8_t *y, const uint8_t *x, size_t n) {
+    uint64_t acc[2] = { get_be64(y + 8), get_be64(y) };
+
+    gf_update(k, acc, x, n, 1);
+    put_be64(y, acc[1]);
+    put_be64(y + 8, acc[0]);
+}
+
+/**
+ * Absorbs n[i] full blocks from x[i] into each of lanes (at most
+ * AES_GF_LANES) independent GHASH accumulators y[i]. The portable
+ * multiplier steps every lane by one block before moving on, so the
+ * lanes' multiply chains overlap instead of running back to back.
+ */
+void aes_ghash_update_lanes(const aes128_gf_key *k, uint8_t *const *y, const uint8_t *const *x,
+                            const uint32_t *n, uint32_t lanes) {
+    uint64_t acc[AES_GF_LANES][2];
+    uint32_t most = 0;
+
+    for (uint32_t i = 0; i < lanes; i++) {
+        acc[i][0] = get_be64(y[i] + 8);
+        acc[i][1] = get_be64(y[i]);
+        most = n[i] > most ? n[i] : most;
+    }
+    if (k->impl != AES_GF_SOFT) {
+        for (uint32_t i = 0; i < lanes; i++) {
+            gf_update(k, acc[i], x[i], n[i], 1);
+        }
+    } else {
+        for (uint32_t j = 0; j < most; j++) {
+            for (uint32_t i = 0; i < lanes; i++) {
+                if (j < n[i]) {
+                    acc[i][0] ^= get_be64(x[i] + j * AES_BLK_LEN + 8);
+                    acc[i][1] ^= get_be64(x[i] + j * AES_BLK_LEN);
+                    gf_dot(acc[i], acc[i], k->h[0]);
+                }
+            }
+        }
+    }
+    for (uint32_t i = 0; i < lanes; i++) {
+        put_be64(y[i], acc[i][1]);
+        put_be64(y[i] + 8, acc[i][0]);
+    }
+}
+
+/**
+ * Multiplies the GHASH accumulator y by H^n, as if n zero blocks had
+ * been absorbed. This joins GHASH values of consecutive pieces:
+ * GHASH(X1 || X2) = GHASH(X1) * H^m ^ GHASH(X2) for m blocks in X2.
+ * n is public, so square-and-multiply may branch on it.
+ */
+void aes_ghash_shift(const aes128_gf_key *k, uint8_t *y, uint64_t n) {
+    uint64_t acc[2] = { get_be64(y + 8), get_be64(y) };
+    uint64_t p[2];
+    int bit = 63;
+
+    if (n == 0) {
+        return;
+    }
+    while (!(n >> bit)) {
+        bit--;
+    }
+    p[0] = k->h[0][0];
+    p[1] = k->h[0][1];
+    while (bit--) {
+        gf_dot(p, p, p);
+        if ((n >> bit) & 1) {
+            gf_dot(p, p, k->h[0]);
+        }
+    }
+    gf_dot(acc, acc, p);
+    put_be64(y, acc[1]);
+    put_be64(y + 8, acc[0]);
+}
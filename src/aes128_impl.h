@@ -0,0 +1,146 @@
+/**
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/> */
+
+#ifndef AES128_IMPL_H
+#define AES128_IMPL_H
+
+#include <string.h>
+#include <aes128_ecb.h>
+#include <aes128_cmac.h>
+#include <aes128_gcm.h>
+
+/* Internal round engines selected by aes128_ecb.c.
+   Not part of the installed API. */
+
+/* Values of aes128_ctx.impl */
+#define AES_IMPL_C     0    /* portable C (T-table or compact loop) */
+#define AES_IMPL_AESNI 1    /* x86 AES instructions */
+#define AES_IMPL_VPAES 2    /* x86 SSSE3 vector permute (constant time) */
+
+/* Cache-line alignment for the shared lookup tables */
+#if defined(_MSC_VER)
+#   define ALIGN64 __declspec(align(64))
+#elif defined(__GNUC__) || defined(__clang__)
+#   define ALIGN64 __attribute__((aligned(64)))
+#else
+#   define ALIGN64
+#endif
+
+/* S-box and inverse S-box (aes128_sbox.c) */
+extern const uint8_t aes_sbox[256];
+extern const uint8_t aes_sbox_inv[256];
+
+/* Blocks handed to aes128_ecb_*_blocks() per call by the modes */
+#define AES_PAR_BLOCKS 8
+
+/* d = a ^ b over one block, a word at a time; d may alias a or b */
+static inline void xor16(uint8_t *d, const uint8_t *a, const uint8_t *b) {
+    uint64_t u[2], v[2];
+
+    memcpy(u, a, AES_BLK_LEN);
+    memcpy(v, b, AES_BLK_LEN);
+    u[0] ^= v[0];
+    u[1] ^= v[1];
+    memcpy(d, u, AES_BLK_LEN);
+}
+
+/* Values of aes128_gf_key.impl */
+#define AES_GF_SOFT  0      /* portable constant-time 64-bit multiplies */
+#define AES_GF_CLMUL 1      /* x86 PCLMULQDQ */
+
+/* Most accumulators aes_ghash_update_lanes() steps together */
+#define AES_GF_LANES 4
+
+/* GHASH and POLYVAL over full blocks (aes128_ghash.c) */
+void aes_ghash_init(aes128_gf_key *k, const uint8_t *h);
+void aes_ghash_update(const aes128_gf_key *k, uint8_t *y, const uint8_t *x, size_t n);
+void aes_ghash_update_lanes(const aes128_gf_key *k, uint8_t *const *y, const uint8_t *const *x,
+                            const uint32_t *n, uint32_t lanes);
+void aes_ghash_shift(const aes128_gf_key *k, uint8_t *y, uint64_t n);
+void aes_polyval_init(aes128_gf_key *k, const uint8_t *h, size_t n);
+void aes_polyval_update(const aes128_gf_key *k, uint8_t *y, const uint8_t *x, size_t n);
+
+/* CMAC chaining over a caller-held y/buf pair (aes128_cmac.c); EAX runs
+   its OMAC lanes through these too */
+void aes_cmac_absorb(const aes128_key *k, uint8_t *y, uint8_t *buf, uint32_t *buf_len,
+                     const uint8_t *x, size_t len);
+void aes_cmac_finish(const aes128_cmac_ctx *c, const uint8_t *y, const uint8_t *buf, uint32_t buf_len,
+                     uint8_t *tag);
+
+#ifdef AES_DUST_TTABLES
+/* 32-bit T-table rounds (aes128_ttable.c) */
+void aes_tt_encrypt(const aes_key_t *rk, uint32_t nr, void *data);
+void aes_tt_decrypt(const aes_key_t *dk, uint32_t nr, void *data);
+void aes_tt_encrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+void aes_tt_decrypt_blocks(const aes_key_t *dk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+#endif
+
+#ifdef AES_DUST_CONSTANT_TIME
+/* Constant-time bitsliced rounds, four blocks at a time (aes128_bitslice.c) */
+uint32_t aes_bs_sub_word(uint32_t w);
+void aes_bs_set_key(uint64_t *sk, const aes_key_t *rk, uint32_t nr);
+void aes_bs_encrypt(const uint64_t *sk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+void aes_bs_decrypt(const uint64_t *sk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+#endif
+
+#if defined(AES_DUST_AESNI) || defined(AES_DUST_VPAES)
+/* CPUID leaf 1 ECX feature bits (aes128_cpu.c) */
+#define AES_CPU_PCLMUL (1u << 1)
+#define AES_CPU_SSSE3  (1u << 9)
+#define AES_CPU_AESNI  (1u << 25)
+
+int aes_cpu_has(uint32_t feature);
+#endif
+
+#ifdef AES_DUST_VPAES
+/* SSSE3 vector-permute rounds, selected at run time (aes128_vpaes.c) */
+void aes_vp_encrypt(const aes_key_t *rk, uint32_t nr, void *data);
+void aes_vp_decrypt(const aes_key_t *rk, uint32_t nr, void *data);
+void aes_vp_encrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+void aes_vp_decrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+#endif
+
+#ifdef AES_DUST_AESNI
+/* AES-NI rounds, selected at run time (aes128_aesni.c) */
+void aes_ni_set_key(aes_key_t *rk, aes_key_t *dk, const void *key);
+uint32_t aes_ni_sub_word(uint32_t w);
+void aes_ni_encrypt(const aes_key_t *rk, uint32_t nr, void *data);
+void aes_ni_decrypt(const aes_key_t *dk, uint32_t nr, void *data);
+void aes_ni_encrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+void aes_ni_decrypt_blocks(const aes_key_t *dk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n);
+#endif
+
+#ifdef AES_DUST_CLMUL
+/* PCLMULQDQ GF(2^128) multiplies and stitched AES-NI GCM, selected at
+   run time (aes128_clmul.c) */
+void aes_clmul_update(const aes128_gf_key *k, uint64_t y[2], const uint8_t *x, size_t n, int be);
+void aes_clmul_gcm_encrypt(const aes_key_t *rk, uint32_t nr, const aes128_gf_key *k,
+                           uint8_t *ctr, uint8_t *y, const uint8_t *in, uint8_t *out, size_t n);
+void aes_clmul_gcm_decrypt(const aes_key_t *rk, uint32_t nr, const aes128_gf_key *k,
+                           uint8_t *ctr, uint8_t *y, const uint8_t *in, uint8_t *out, size_t n);
+#endif
+
+#endif
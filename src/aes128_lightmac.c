@@ -25,6 +25,7 @@
   For more information, please refer to <http://unlicense.org/> */
 
 #include <aes128_lightmac.h>
+#include "aes128_impl.h"
 
 static void lightmac_encode_counter(uint64_t counter, uint8_t *output, uint8_t s_bytes) {
     for (int i = (int)s_bytes - 1; i >= 0; --i) {
@@ -33,12 +34,6 @@ static void lightmac_encode_counter(uint64_t counter, uint8_t *output, uint8_t s
     }
 }
 
-static void lightmac_xor_block(uint8_t *dst, const uint8_t *src) {
-    for (uint8_t i = 0; i < AES_BLK_LEN; ++i) {
-        dst[i] ^= src[i];
-    }
-}
-
 static int lightmac_use_k1(aes128_lightmac_ctx *ctx) {
     if (ctx->key_state != 1) {
         aes128_set_key(&ctx->aes, ctx->k1);
@@ -68,11 +63,37 @@ static int lightmac_process_buf(aes128_lightmac_ctx *ctx) {
     lightmac_encode_counter(ctx->block_index, block, ctx->s_bytes);
     memcpy(block + ctx->s_bytes, ctx->buf, ctx->r_bytes);
     aes128_ecb_encrypt(&ctx->aes, block);
-    lightmac_xor_block(ctx->v, block);
+    xor16(ctx->v, ctx->v, block);
     ctx->block_index++;
     return AES128_LIGHTMAC_OK;
 }
 
+/* Processes n full message blocks read directly from p, encrypting them
+   together through the multi-block engine. */
+static int lightmac_process_blocks(aes128_lightmac_ctx *ctx, const uint8_t *p, uint32_t n) {
+    uint8_t blocks[AES_PAR_BLOCKS * AES_BLK_LEN];
+
+    if (ctx->s_bits < 64) {
+        uint64_t limit = (1ULL << ctx->s_bits) - 1;
+        if (ctx->block_index > limit || n - 1 > limit - ctx->block_index) {
+            ctx->status = AES128_LIGHTMAC_TOO_LONG;
+            return ctx->status;
+        }
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t *block = blocks + i * AES_BLK_LEN;
+        lightmac_encode_counter(ctx->block_index + i, block, ctx->s_bytes);
+        memcpy(block + ctx->s_bytes, p + i * ctx->r_bytes, ctx->r_bytes);
+    }
+    aes128_ecb_encrypt_blocks(&ctx->aes, blocks, blocks, n);
+    for (uint32_t i = 0; i < n; i++) {
+        xor16(ctx->v, ctx->v, blocks + i * AES_BLK_LEN);
+    }
+    ctx->block_index += n;
+    return AES128_LIGHTMAC_OK;
+}
+
 int aes128_lightmac_init(aes128_lightmac_ctx *ctx, const uint8_t *k1, const uint8_t *k2,
                          uint8_t s_bits, uint8_t t_bits) {
     if (ctx == NULL || k1 == NULL || k2 == NULL) {
@@ -135,6 +156,19 @@ int aes128_lightmac_update(aes128_lightmac_ctx *ctx, const uint8_t *data, uint32
 
     const uint8_t *p = data;
     while (len > 0) {
+        /* Full blocks that cannot be the last one skip the buffer */
+        if (ctx->buf_len == 0 && len > ctx->r_bytes) {
+            uint32_t n = (len - 1) / ctx->r_bytes;
+            if (n > AES_PAR_BLOCKS) {
+                n = AES_PAR_BLOCKS;
+            }
+            if (lightmac_process_blocks(ctx, p, n) != AES128_LIGHTMAC_OK) {
+                return ctx->status;
+            }
+            p += n * ctx->r_bytes;
+            len -= n * ctx->r_bytes;
+            continue;
+        }
         uint32_t take = (uint32_t)(ctx->r_bytes - ctx->buf_len);
         if (take > len) {
             take = len;
@@ -170,7 +204,7 @@ int aes128_lightmac_final(aes128_lightmac_ctx *ctx, uint8_t *tag) {
     }
     last[ctx->buf_len] = 0x80;
 
-    lightmac_xor_block(ctx->v, last);
+    xor16(ctx->v, ctx->v, last);
 
     lightmac_use_k2(ctx);
     uint8_t out[AES_BLK_LEN];
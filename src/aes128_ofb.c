@@ -27,23 +27,17 @@
 
 #include <aes128_ofb.h>
 
-/**
- * Encrypt (or decrypt) data in-place using AES-128 in Output Feedback (OFB) mode.
- * 
- * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
- * @param data  Pointer to the data buffer to encrypt or decrypt.
- * @param len   Number of bytes in the data buffer.
- */
-void aes128_ofb_encrypt(aes128_ctx *c, void *data, uint32_t len) {
+/* OFB keystream with key k, fed back through the 16-byte ofb */
+static void ofb_crypt(const aes128_key *k, uint8_t *ofb, void *data, uint32_t len) {
     uint32_t i, r;
-    uint8_t t[AES_BLK_LEN], * p = data, *iv = c->iv;
+    uint8_t t[AES_BLK_LEN], * p = data, *iv = ofb;
 
     // copy IV to local buffer
     for (i = 0; i < AES_BLK_LEN; i++)t[i] = iv[i];
 
     while (len) {
         // encrypt t
-        aes128_ecb_encrypt(c, t);
+        aes128_key_encrypt(k, t);
         // XOR plaintext with ciphertext
         r = len > AES_BLK_LEN ? AES_BLK_LEN : len;
         for (i = 0; i < r; i++) p[i] ^= t[i];
@@ -53,7 +47,18 @@ void aes128_ofb_encrypt(aes128_ctx *c, void *data, uint32_t len) {
         p += r;
     }
     // update iv in context
-    for (i = 0; i < AES_BLK_LEN; i++) c->iv[i] = iv[i];
+    for (i = 0; i < AES_BLK_LEN; i++) ofb[i] = iv[i];
+}
+
+/**
+ * Encrypt (or decrypt) data in-place using AES-128 in Output Feedback (OFB) mode.
+ * 
+ * @param c     Pointer to the AES-128 context (must hold a valid IV in c->iv).
+ * @param data  Pointer to the data buffer to encrypt or decrypt.
+ * @param len   Number of bytes in the data buffer.
+ */
+void aes128_ofb_encrypt(aes128_ctx *c, void *data, uint32_t len) {
+    ofb_crypt(&c->key, c->iv, data, len);
 }
 /**
  * Decrypt data in-place using AES-128 in Output Feedback (OFB) mode.
@@ -62,3 +67,14 @@ void aes128_ofb_encrypt(aes128_ctx *c, void *data, uint32_t len) {
 void aes128_ofb_decrypt(aes128_ctx *c, void *data, uint32_t len) {
     aes128_ofb_encrypt(c, data, len);
 }
+
+/**
+ * OFB encryption (or decryption) on a stream that references a shared key.
+ */
+void aes128_ofb_encrypt_stream(aes128_stream *s, void *data, uint32_t len) {
+    ofb_crypt(s->key, s->iv, data, len);
+}
+
+void aes128_ofb_decrypt_stream(aes128_stream *s, void *data, uint32_t len) {
+    ofb_crypt(s->key, s->iv, data, len);
+}
@@ -0,0 +1,156 @@
+/**
+  This is free and unencumbered software released into the public domain.
+  
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+  
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+  
+  For more information, please refer to <http://unlicense.org/>
+ */
+
+#include "aes128_impl.h"
+
+#include <tmmintrin.h>
+
+/*
+ * Constant-time single-block rounds built on the SSSE3 byte permute.
+ *
+ * The whole state lives in one XMM register. SubBytes is evaluated as
+ * sixteen 16-entry PSHUFB lookups, one per high nibble, over S-box rows
+ * that are all loaded on every call: a row only contributes to the bytes
+ * whose high nibble selects it, so no memory address depends on the data.
+ * ShiftRows and the byte rotations inside MixColumns are fixed permutes.
+ */
+
+/* Byte lookup through a 256-entry table held as 16 rows of 16 */
+static inline __m128i vp_lookup(__m128i x, const uint8_t *table) {
+    const __m128i hi  = _mm_set1_epi8(0x10);
+    const __m128i sat = _mm_set1_epi8(0x70);
+    __m128i r = _mm_setzero_si128();
+
+    for (int h = 0; h < 16; h++) {
+        /* Bytes whose high nibble is h map to 0x70..0x7f; all others
+           saturate to 0x80 or above and select zero. */
+        __m128i idx = _mm_adds_epu8(x, sat);
+        r = _mm_xor_si128(r, _mm_shuffle_epi8(_mm_load_si128((const __m128i*)(table + 16 * h)), idx));
+        x = _mm_sub_epi8(x, hi);
+    }
+    return r;
+}
+
+/* Multiply each byte by 2 in GF(2^8) */
+static inline __m128i vp_xtime(__m128i x) {
+    __m128i m = _mm_cmpgt_epi8(_mm_setzero_si128(), x);
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(m, _mm_set1_epi8(0x1b)));
+}
+
+static inline __m128i vp_shift_rows(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_setr_epi8(0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11));
+}
+
+static inline __m128i vp_inv_shift_rows(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3));
+}
+
+/* Rotate each column word right by 8 and 16 bits */
+static inline __m128i vp_rot8(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+
+static inline __m128i vp_rot16(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+
+static inline __m128i vp_mix_columns(__m128i x) {
+    __m128i r8 = vp_rot8(x);
+    __m128i t = _mm_xor_si128(r8, x);
+    return _mm_xor_si128(_mm_xor_si128(r8, vp_rot16(t)), vp_xtime(t));
+}
+
+static inline __m128i vp_inv_mix_columns(__m128i x) {
+    x = _mm_xor_si128(x, vp_xtime(vp_xtime(_mm_xor_si128(vp_rot16(x), x))));
+    return vp_mix_columns(x);
+}
+
+static inline __m128i vp_key(const aes_key_t *rk) {
+    return _mm_loadu_si128((const __m128i*)rk);
+}
+
+/**
+ * Encrypts a single 16-byte block in-place.
+ */
+void aes_vp_encrypt(const aes_key_t *rk, uint32_t nr, void *data) {
+    __m128i x = _mm_loadu_si128((const __m128i*)data);
+
+    x = _mm_xor_si128(x, vp_key(&rk[0]));
+    for (uint32_t i = 1; i < nr; i++) {
+        x = vp_mix_columns(vp_shift_rows(vp_lookup(x, aes_sbox)));
+        x = _mm_xor_si128(x, vp_key(&rk[i]));
+    }
+    x = vp_shift_rows(vp_lookup(x, aes_sbox));
+    x = _mm_xor_si128(x, vp_key(&rk[nr]));
+    _mm_storeu_si128((__m128i*)data, x);
+}
+
+/**
+ * Decrypts a single 16-byte block in-place.
+ */
+void aes_vp_decrypt(const aes_key_t *rk, uint32_t nr, void *data) {
+    __m128i x = _mm_loadu_si128((const __m128i*)data);
+
+    x = _mm_xor_si128(x, vp_key(&rk[nr]));
+    for (uint32_t i = nr - 1; i > 0; i--) {
+        x = vp_lookup(vp_inv_shift_rows(x), aes_sbox_inv);
+        x = vp_inv_mix_columns(_mm_xor_si128(x, vp_key(&rk[i])));
+    }
+    x = vp_lookup(vp_inv_shift_rows(x), aes_sbox_inv);
+    x = _mm_xor_si128(x, vp_key(&rk[0]));
+    _mm_storeu_si128((__m128i*)data, x);
+}
+
+/**
+ * Encrypts n blocks from in to out. The rounds are bound by the single
+ * shuffle port rather than by latency, so unlike the other engines there
+ * is nothing to gain from interleaving blocks; they are done in turn.
+ */
+void aes_vp_encrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    for (; n > 0; n--) {
+        if (in != out) {
+            memcpy(out, in, AES_BLK_LEN);
+        }
+        aes_vp_encrypt(rk, nr, out);
+        in  += AES_BLK_LEN;
+        out += AES_BLK_LEN;
+    }
+}
+
+/**
+ * Decrypts n blocks from in to out, one at a time.
+ */
+void aes_vp_decrypt_blocks(const aes_key_t *rk, uint32_t nr, const uint8_t *in, uint8_t *out, uint32_t n) {
+    for (; n > 0; n--) {
+        if (in != out) {
+            memcpy(out, in, AES_BLK_LEN);
+        }
+        aes_vp_decrypt(rk, nr, out);
+        in  += AES_BLK_LEN;
+        out += AES_BLK_LEN;
+    }
+}
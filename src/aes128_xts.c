@@ -26,6 +26,7 @@
  */
 
 #include <aes128_xts.h>
+#include "aes128_impl.h"
 
 /* Multiply tweak by x in GF(2^128) using little-endian byte order. */
 static void xts_gf_mul_x(uint8_t tweak[AES_BLK_LEN]) {
@@ -40,11 +41,12 @@ static void xts_gf_mul_x(uint8_t tweak[AES_BLK_LEN]) {
     }
 }
 
-static int aes128_xts_crypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
+static int aes128_xts_crypt(const aes128_key* data_key, const aes128_key* tweak_key,
                             const void* tweak_in, void* data, uint32_t len,
                             int decrypt) {
     uint8_t tweak[AES_BLK_LEN];
-    uint8_t block[AES_BLK_LEN];
+    uint8_t tweaks[AES_PAR_BLOCKS * AES_BLK_LEN];
+    uint8_t block[AES_PAR_BLOCKS * AES_BLK_LEN];
     uint8_t *p = (uint8_t*)data;
 
     if (len == 0) {
@@ -55,26 +57,35 @@ static int aes128_xts_crypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
     }
 
     memcpy(tweak, tweak_in, AES_BLK_LEN);
-    aes128_ecb_encrypt(tweak_ctx, tweak);
+    aes128_key_encrypt(tweak_key, tweak);
 
     while (len) {
-        for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-            block[i] = (uint8_t)(p[i] ^ tweak[i]);
+        uint32_t n = len / AES_BLK_LEN;
+        if (n > AES_PAR_BLOCKS) {
+            n = AES_PAR_BLOCKS;
+        }
+
+        /* Derive the tweaks for this run and whiten the input */
+        for (uint32_t j = 0; j < n * AES_BLK_LEN; j += AES_BLK_LEN) {
+            memcpy(tweaks + j, tweak, AES_BLK_LEN);
+            for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
+                block[j + i] = (uint8_t)(p[j + i] ^ tweak[i]);
+            }
+            xts_gf_mul_x(tweak);
         }
 
         if (decrypt) {
-            aes128_ecb_decrypt(data_ctx, block);
+            aes128_key_decrypt_blocks(data_key, block, block, n);
         } else {
-            aes128_ecb_encrypt(data_ctx, block);
+            aes128_key_encrypt_blocks(data_key, block, block, n);
         }
 
-        for (uint32_t i = 0; i < AES_BLK_LEN; i++) {
-            p[i] = (uint8_t)(block[i] ^ tweak[i]);
+        for (uint32_t i = 0; i < n * AES_BLK_LEN; i++) {
+            p[i] = (uint8_t)(block[i] ^ tweaks[i]);
         }
 
-        xts_gf_mul_x(tweak);
-        p += AES_BLK_LEN;
-        len -= AES_BLK_LEN;
+        p += n * AES_BLK_LEN;
+        len -= n * AES_BLK_LEN;
     }
 
     return 1;
@@ -82,10 +93,24 @@ static int aes128_xts_crypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
 
 int aes128_xts_encrypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
                        const void* tweak, void* data, uint32_t len) {
-    return aes128_xts_crypt(data_ctx, tweak_ctx, tweak, data, len, 0);
+    return aes128_xts_crypt(&data_ctx->key, &tweak_ctx->key, tweak, data, len, 0);
 }
 
 int aes128_xts_decrypt(aes128_ctx* data_ctx, aes128_ctx* tweak_ctx,
                        const void* tweak, void* data, uint32_t len) {
-    return aes128_xts_crypt(data_ctx, tweak_ctx, tweak, data, len, 1);
+    return aes128_xts_crypt(&data_ctx->key, &tweak_ctx->key, tweak, data, len, 1);
+}
+
+/*
+ * XTS with shared expanded keys. XTS keeps no state between calls, so the
+ * keys are all that is needed and many sectors may be processed at once.
+ */
+int aes128_xts_encrypt_key(const aes128_key* data_key, const aes128_key* tweak_key,
+                           const void* tweak, void* data, uint32_t len) {
+    return aes128_xts_crypt(data_key, tweak_key, tweak, data, len, 0);
+}
+
+int aes128_xts_decrypt_key(const aes128_key* data_key, const aes128_key* tweak_key,
+                           const void* tweak, void* data, uint32_t len) {
+    return aes128_xts_crypt(data_key, tweak_key, tweak, data, len, 1);
 }
@@ -12,6 +12,7 @@
 #include <aes128_cbc.h>
 #include <aes128_cfb.h>
 #include <aes128_ccm.h>
+#include <aes128_cmac.h>
 #include <aes128_ofb.h>
 #include <aes128_ctr.h>
 #include <aes128_eax.h>
@@ -32,6 +33,27 @@ static void print_hex(const char *label, const void *buf, size_t len)
     putchar('\n');
 }
 
+/* xorshift32 filler for keys, nonces and data that no published vector
+   covers; the sequence depends on the tests run before. */
+static uint32_t prng_state = 0x6b8b4567U;
+
+static uint32_t prng_next(void)
+{
+    uint32_t x = prng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    prng_state = x;
+    return x;
+}
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)prng_next();
+    }
+}
+
 /* ================================================================
  *  1. OFB mode test-vectors & tests                                
  * ================================================================*/
@@ -514,6 +536,193 @@ static int ecb_test(void)
     return 0;
 }
 
+/* Multi-block ECB must match the single-block calls for every run length,
+   in-place and out-of-place, and CBC decryption built on it must undo
+   CBC encryption. */
+static int ecb_blocks_test(void)
+{
+    aes128_ctx ctx;
+    uint8_t pt[19 * AES_BLK_LEN], ref[19 * AES_BLK_LEN], out[19 * AES_BLK_LEN];
+    uint8_t iv[AES_IV_LEN] = {0};
+    int fail = 0;
+
+    puts("\n**** AES-128 ECB Multi-block Test ****\n");
+
+    for (size_t i = 0; i < sizeof pt; ++i) pt[i] = (uint8_t)(i * 7 + 3);
+
+    aes128_init_ctx(&ctx);
+    aes128_set_key(&ctx, ecb_key[0]);
+
+    for (uint32_t n = 0; n <= 19; ++n) {
+        memcpy(ref, pt, n * AES_BLK_LEN);
+        for (uint32_t j = 0; j < n; ++j) aes128_ecb_encrypt(&ctx, ref + j * AES_BLK_LEN);
+
+        aes128_ecb_encrypt_blocks(&ctx, pt, out, n);
+        if (memcmp(out, ref, n * AES_BLK_LEN)) fail = 1;
+
+        aes128_ecb_decrypt_blocks(&ctx, out, out, n);
+        if (memcmp(out, pt, n * AES_BLK_LEN)) fail = 1;
+    }
+    printf(" ECB blocks            : %s\n", fail ? "FAILED" : "OK");
+
+    memcpy(out, pt, sizeof pt);
+    aes128_set_iv(&ctx, iv);
+    aes128_cbc_encrypt(&ctx, out, sizeof out);
+    aes128_set_iv(&ctx, iv);
+    aes128_cbc_decrypt(&ctx, out, sizeof out);
+    int cbc_fail = memcmp(out, pt, sizeof pt) != 0;
+    printf(" CBC decrypt, 19 blocks: %s\n", cbc_fail ? "FAILED" : "OK");
+
+    return fail | cbc_fail;
+}
+
+/* Streams sharing one expanded key must match the self-contained
+   context API, and must not disturb each other. */
+static int shared_key_test(void)
+{
+    aes128_key key;
+    aes128_ctx ctx, ctx2;
+    aes128_stream s1, s2;
+    uint8_t a[5 * AES_BLK_LEN], b[5 * AES_BLK_LEN], ref[5 * AES_BLK_LEN];
+    uint8_t nonce[12] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb};
+    int fail = 0;
+
+    puts("\n**** AES-128 Shared Key Test ****\n");
+
+    for (size_t i = 0; i < sizeof a; ++i) a[i] = (uint8_t)(i * 13 + 1);
+
+    aes128_key_expand(&key, cbc_key[0]);
+    aes128_init_ctx(&ctx);
+    aes128_set_key(&ctx, cbc_key[0]);
+
+    /* CBC: two interleaved streams on one key against a context */
+    aes128_stream_init(&s1, &key);
+    aes128_stream_init(&s2, &key);
+    aes128_stream_set_iv(&s1, cbc_iv[0]);
+    aes128_stream_set_iv(&s2, cbc_iv[0]);
+    aes128_set_iv(&ctx, cbc_iv[0]);
+    memcpy(ref, a, sizeof a);
+    memcpy(b, a, sizeof a);
+    aes128_cbc_encrypt(&ctx, ref, sizeof ref);
+    aes128_cbc_encrypt_stream(&s1, b, 2 * AES_BLK_LEN);
+    aes128_cbc_encrypt_stream(&s2, a, 3 * AES_BLK_LEN);
+    aes128_cbc_encrypt_stream(&s1, b + 2 * AES_BLK_LEN, 3 * AES_BLK_LEN);
+    if (memcmp(b, ref, sizeof b) || memcmp(a, ref, 3 * AES_BLK_LEN)) fail = 1;
+    aes128_stream_set_iv(&s1, cbc_iv[0]);
+    aes128_cbc_decrypt_stream(&s1, b, sizeof b);
+    for (size_t i = 0; i < sizeof b; ++i) if (b[i] != (uint8_t)(i * 13 + 1)) fail = 1;
+    printf(" CBC streams : %s\n", fail ? "FAILED" : "OK");
+
+    /* CTR */
+    int ctr_fail = 0;
+    memcpy(ref, b, sizeof b);
+    aes128_ctr_set(&ctx, nonce);
+    aes128_ctr_encrypt(&ctx, ref, 32);
+    aes128_ctr_encrypt(&ctx, ref + 32, sizeof ref - 32);
+    aes128_ctr_set_stream(&s2, nonce);
+    aes128_ctr_encrypt_stream(&s2, b, sizeof b);
+    if (memcmp(b, ref, sizeof b)) ctr_fail = 1;
+    printf(" CTR stream  : %s\n", ctr_fail ? "FAILED" : "OK");
+
+    /* XTS with two shared keys */
+    int xts_fail = 0;
+    aes128_key k1, k2;
+    aes128_key_expand(&k1, xts_key[1]);
+    aes128_key_expand(&k2, xts_key[1] + 16);
+    aes128_set_key(&ctx, xts_key[1]);
+    aes128_set_key(&ctx2, xts_key[1] + 16);
+    memcpy(ref, b, sizeof b);
+    aes128_xts_encrypt(&ctx, &ctx2, xts_tweak[1], ref, sizeof ref);
+    aes128_xts_encrypt_key(&k1, &k2, xts_tweak[1], b, sizeof b);
+    if (memcmp(b, ref, sizeof b)) xts_fail = 1;
+    aes128_xts_decrypt_key(&k1, &k2, xts_tweak[1], b, sizeof b);
+    aes128_xts_decrypt(&ctx, &ctx2, xts_tweak[1], ref, sizeof ref);
+    if (memcmp(b, ref, sizeof b)) xts_fail = 1;
+    printf(" XTS keys    : %s\n", xts_fail ? "FAILED" : "OK");
+
+    return fail | ctr_fail | xts_fail;
+}
+
+/* AES-192 and AES-256: FIPS-197 appendix C, NIST GCM test case 14 and
+   RFC 8452 appendix C.2 */
+static const uint8_t fips_plain[16] = {
+    0x00,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0xaa,0xbb,0xcc,0xdd,0xee,0xff
+};
+static const uint8_t fips_cipher192[16] = {
+    0xdd,0xa9,0x7c,0xa4,0x86,0x4c,0xdf,0xe0,0x6e,0xaf,0x70,0xa0,0xec,0x0d,0x71,0x91
+};
+static const uint8_t fips_cipher256[16] = {
+    0x8e,0xa2,0xb7,0xca,0x51,0x67,0x45,0xbf,0xea,0xfc,0x49,0x90,0x4b,0x49,0x60,0x89
+};
+static const uint8_t gcm256_ct14[16] = {
+    0xce,0xa7,0x40,0x3d,0x4d,0x60,0x6b,0x6e,0x07,0x4e,0xc5,0xd3,0xba,0xf3,0x9d,0x18
+};
+static const uint8_t gcm256_tag14[16] = {
+    0xd0,0xd1,0xc8,0xa7,0x99,0x99,0x6b,0xf0,0x26,0x5b,0x98,0xb5,0xd4,0x8a,0xb9,0x19
+};
+static const uint8_t siv256_tag1[16] = {
+    0x07,0xf5,0xf4,0x16,0x9b,0xbf,0x55,0xa8,0x40,0x0c,0xd4,0x7e,0xa6,0xfd,0x40,0x0f
+};
+static const uint8_t siv256_ct2[8] = {0xc2,0xef,0x32,0x8e,0x5c,0x71,0xc8,0x3b};
+static const uint8_t siv256_tag2[16] = {
+    0x84,0x31,0x22,0x13,0x0f,0x73,0x64,0xb7,0x61,0xe0,0xb9,0x74,0x27,0xe3,0xdf,0x28
+};
+
+static int aes256_test(void)
+{
+    aes128_ctx ctx;
+    uint8_t key[32], blk[4 * AES_BLK_LEN], tag[16];
+    uint8_t zero[32] = {0};
+    int fail = 0;
+
+    puts("\n**** AES-192 / AES-256 Test ****\n");
+
+    for (size_t i = 0; i < sizeof key; ++i) key[i] = (uint8_t)i;
+
+    for (uint32_t len = 24; len <= 32; len += 8) {
+        const uint8_t *ct = len == 24 ? fips_cipher192 : fips_cipher256;
+        int f = !aes128_set_key_len(&ctx, key, len);
+
+        memcpy(blk, fips_plain, 16);
+        aes128_ecb_encrypt(&ctx, blk);
+        if (memcmp(blk, ct, 16)) f = 1;
+        aes128_ecb_decrypt(&ctx, blk);
+        if (memcmp(blk, fips_plain, 16)) f = 1;
+
+        for (int j = 0; j < 4; ++j) memcpy(blk + 16 * j, fips_plain, 16);
+        aes128_ecb_encrypt_blocks(&ctx, blk, blk, 4);
+        for (int j = 0; j < 4; ++j) if (memcmp(blk + 16 * j, ct, 16)) f = 1;
+        aes128_ecb_decrypt_blocks(&ctx, blk, blk, 4);
+        for (int j = 0; j < 4; ++j) if (memcmp(blk + 16 * j, fips_plain, 16)) f = 1;
+
+        printf(" AES-%u ECB        : %s\n", (unsigned)(len * 8), f ? "FAILED" : "OK");
+        fail |= f;
+    }
+
+    int bad = aes128_set_key_len(&ctx, key, 20) == 0;
+    printf(" Bad key length    : %s\n", bad ? "OK" : "FAILED");
+    fail |= !bad;
+
+    int g = aes128_gcm_encrypt(zero, 32, zero, 12, zero, 16, NULL, 0, blk, tag) != 0;
+    if (memcmp(blk, gcm256_ct14, 16) || memcmp(tag, gcm256_tag14, 16)) g = 1;
+    if (aes128_gcm_decrypt(zero, 32, zero, 12, blk, 16, NULL, 0, tag, blk + 16) ||
+        memcmp(blk + 16, zero, 16)) g = 1;
+    printf(" AES-256 GCM       : %s\n", g ? "FAILED" : "OK");
+    fail |= g;
+
+    uint8_t siv_key[32] = {0x01}, siv_nonce[12] = {0x03}, siv_pt[8] = {0x01};
+    int v = aes128_gcm_siv_encrypt(siv_key, 32, siv_nonce, 12, NULL, 0, NULL, 0, blk, tag) != 0;
+    if (memcmp(tag, siv256_tag1, 16)) v = 1;
+    if (aes128_gcm_siv_encrypt(siv_key, 32, siv_nonce, 12, NULL, 0, siv_pt, 8, blk, tag) ||
+        memcmp(blk, siv256_ct2, 8) || memcmp(tag, siv256_tag2, 16)) v = 1;
+    if (aes128_gcm_siv_decrypt(siv_key, 32, siv_nonce, 12, NULL, 0, siv256_ct2, 8, siv256_tag2, blk + 16) ||
+        memcmp(blk + 16, siv_pt, 8)) v = 1;
+    printf(" AES-256 GCM-SIV   : %s\n", v ? "FAILED" : "OK");
+    fail |= v;
+
+    return fail;
+}
+
 /* ================================================================
  * 7. EAX mode
  * ================================================================*/
@@ -562,6 +771,28 @@ static const uint8_t eax_tag3[16] = {
     0x3a,0x59,0xf2,0x38,0xa2,0x3e,0x39,0x19,0x9d,0xc9,0x26,0x66,0x26,0xc4,0x0f,0x80
 };
 
+/* Rogaway et al. (2003), the 21-byte test vector: spans two blocks */
+static const uint8_t eax_key4[16] = {
+    0x83,0x95,0xfc,0xf1,0xe9,0x5b,0xeb,0xd6,0x97,0xbd,0x01,0x0b,0xc7,0x66,0xaa,0xc3
+};
+static const uint8_t eax_nonce4[16] = {
+    0x22,0xe7,0xad,0xd9,0x3c,0xfc,0x63,0x93,0xc5,0x7e,0xc0,0xb3,0xc1,0x7d,0x6b,0x44
+};
+static const uint8_t eax_aad4[8] = {
+    0x12,0x67,0x35,0xfc,0xc3,0x20,0xd2,0x5a
+};
+static const uint8_t eax_msg4[21] = {
+    0xca,0x40,0xd7,0x44,0x6e,0x54,0x5f,0xfa,0xed,0x3b,0xd1,0x2a,0x74,0x0a,0x65,0x9f,
+    0xfb,0xbb,0x3c,0xea,0xb7
+};
+static const uint8_t eax_ct4[21] = {
+    0xcb,0x89,0x20,0xf8,0x7a,0x6c,0x75,0xcf,0xf3,0x96,0x27,0xb5,0x6e,0x3e,0xd1,0x97,
+    0xc5,0x52,0xd2,0x95,0xa7
+};
+static const uint8_t eax_tag4[16] = {
+    0xcf,0xc4,0x6a,0xfc,0x25,0x3b,0x46,0x52,0xb1,0xaf,0x37,0x95,0xb1,0x24,0xab,0x6e
+};
+
 static int eax_test(void)
 {
     puts("\n**** AES-128 EAX Test ****\n");
@@ -640,7 +871,139 @@ static int eax_test(void)
     printf("EAX #3 decrypt: %s\n",
            memcmp(dec, eax_msg3, sizeof eax_msg3) ? "FAILED" : "OK");
 
-    return 0;
+    /* Keyed context: vector #2 twice under one setup, in place, then a
+       forged tag */
+    aes128_eax_ctx c;
+    int bad = aes128_eax_init(&c, eax_key2, 15) != -1 ||
+              aes128_eax_init(&c, eax_key2, sizeof eax_key2) != 0;
+    for (int r = 0; r < 2 && !bad; r++) {
+        memcpy(out, eax_msg2, sizeof eax_msg2);
+        bad |= aes128_eax_encrypt_ctx(&c, eax_nonce2, sizeof eax_nonce2,
+                                      eax_aad2, sizeof eax_aad2,
+                                      out, sizeof eax_msg2, out, tag) != 0;
+        bad |= memcmp(out, eax_ct2, sizeof eax_ct2) != 0 ||
+               memcmp(tag, eax_tag2, AES_BLK_LEN) != 0;
+        bad |= aes128_eax_decrypt_ctx(&c, eax_nonce2, sizeof eax_nonce2,
+                                      eax_aad2, sizeof eax_aad2,
+                                      out, sizeof eax_ct2, tag, out) != 0;
+        bad |= memcmp(out, eax_msg2, sizeof eax_msg2) != 0;
+    }
+    tag[0] ^= 1;
+    bad |= aes128_eax_decrypt_ctx(&c, eax_nonce2, sizeof eax_nonce2,
+                                  eax_aad2, sizeof eax_aad2,
+                                  eax_ct2, sizeof eax_ct2, tag, dec) != -1;
+    printf("EAX keyed context: %s\n", bad ? "FAILED" : "OK");
+
+    return bad;
+}
+
+static int eax_stream_test(void)
+{
+    puts("\n**** AES-128 EAX streaming Test ****\n");
+
+    static const uint32_t chunks[] = { 1, 15, 16, 17, 3, 64, 5, 200 };
+    uint8_t key[16], nonce[20], pt[200], aad[40], ref[200], ref_tag[16];
+    uint8_t ct[200], dec[200], tag[16];
+    aes128_eax_ctx ec;
+    aes128_eax_stream es;
+    int failed = 0;
+
+    /* Vector #4: the AAD a byte at a time, the message cut at every offset */
+    if (aes128_eax_init(&ec, eax_key4, sizeof eax_key4) != 0) {
+        puts("EAX stream init failed.");
+        return 1;
+    }
+    for (uint32_t cut = 0; cut <= sizeof eax_msg4; cut++) {
+        aes128_eax_stream_init(&es, &ec, eax_nonce4, sizeof eax_nonce4);
+        for (uint32_t i = 0; i < sizeof eax_aad4; i++) {
+            aes128_eax_stream_aad(&es, eax_aad4 + i, 1);
+        }
+        aes128_eax_stream_encrypt(&es, eax_msg4, ct, cut);
+        aes128_eax_stream_encrypt(&es, eax_msg4 + cut, ct + cut, sizeof eax_msg4 - cut);
+        if (aes128_eax_stream_final(&es, tag) ||
+            memcmp(ct, eax_ct4, sizeof eax_ct4) || memcmp(tag, eax_tag4, AES_BLK_LEN)) {
+            printf("EAX stream #4 cut at %u: FAILED\n", cut);
+            failed = 1;
+        }
+    }
+    print_hex("Tag       ", tag, sizeof tag);
+    printf("EAX stream #4 encrypt: %s\n", failed ? "FAILED" : "OK");
+
+    aes128_eax_stream_init(&es, &ec, eax_nonce4, sizeof eax_nonce4);
+    aes128_eax_stream_aad(&es, eax_aad4, sizeof eax_aad4);
+    for (uint32_t i = 0; i < sizeof eax_ct4; i++) {
+        aes128_eax_stream_decrypt(&es, eax_ct4 + i, dec + i, 1);
+    }
+    if (aes128_eax_stream_verify(&es, eax_tag4) != 0 || memcmp(dec, eax_msg4, sizeof eax_msg4)) {
+        puts("EAX stream #4 decrypt: FAILED");
+        failed = 1;
+    } else {
+        puts("EAX stream #4 decrypt: OK");
+    }
+
+    /* Longer input against the one-shot call, in eight chunk sizes */
+    fill_random(key, sizeof key);
+    fill_random(nonce, sizeof nonce);
+    fill_random(aad, sizeof aad);
+    fill_random(pt, sizeof pt);
+    aes128_eax_init(&ec, key, sizeof key);
+    aes128_eax_encrypt_ctx(&ec, nonce, sizeof nonce, aad, sizeof aad, pt, sizeof pt, ref, ref_tag);
+
+    for (uint32_t c = 0; c < sizeof chunks / sizeof chunks[0]; c++) {
+        uint32_t step = chunks[c], off;
+        int chunk_failed = 0;
+
+        aes128_eax_stream_init(&es, &ec, nonce, sizeof nonce);
+        for (off = 0; off < sizeof aad; off += step) {
+            aes128_eax_stream_aad(&es, aad + off, sizeof aad - off < step ? sizeof aad - off : step);
+        }
+        for (off = 0; off < sizeof pt; off += step) {
+            uint32_t n = sizeof pt - off < step ? sizeof pt - off : step;
+            aes128_eax_stream_encrypt(&es, pt + off, ct + off, n);
+        }
+        if (aes128_eax_stream_aad(&es, aad, 1) == 0) {
+            chunk_failed = 1;    /* AAD after data */
+        }
+        if (aes128_eax_stream_final(&es, tag) || memcmp(ct, ref, sizeof ct) || memcmp(tag, ref_tag, 16)) {
+            chunk_failed = 1;
+        }
+
+        /* Decrypt in place, one byte more per chunk */
+        memcpy(dec, ct, sizeof dec);
+        aes128_eax_stream_init(&es, &ec, nonce, sizeof nonce);
+        aes128_eax_stream_aad(&es, aad, sizeof aad);
+        for (off = 0; off < sizeof dec; off += step + 1) {
+            uint32_t n = sizeof dec - off < step + 1 ? sizeof dec - off : step + 1;
+            aes128_eax_stream_decrypt(&es, dec + off, dec + off, n);
+        }
+        if (aes128_eax_stream_verify(&es, tag) != 0 || memcmp(dec, pt, sizeof pt)) {
+            chunk_failed = 1;
+        }
+        printf("EAX stream %u-byte chunks: %s\n", step, chunk_failed ? "FAILED" : "OK");
+        failed |= chunk_failed;
+    }
+
+    /* A tampered tag; an empty message; a second final */
+    aes128_eax_stream_init(&es, &ec, nonce, sizeof nonce);
+    aes128_eax_stream_aad(&es, aad, sizeof aad);
+    aes128_eax_stream_decrypt(&es, ref, dec, sizeof ref);
+    tag[15] ^= 0x80;
+    if (aes128_eax_stream_verify(&es, tag) == 0) {
+        puts("EAX stream tampered tag accepted: FAILED");
+        failed = 1;
+    }
+    aes128_eax_encrypt_ctx(&ec, nonce, 0, NULL, 0, NULL, 0, NULL, ref_tag);
+    aes128_eax_stream_init(&es, &ec, nonce, 0);
+    if (aes128_eax_stream_final(&es, tag) || memcmp(tag, ref_tag, 16)) {
+        puts("EAX stream empty message: FAILED");
+        failed = 1;
+    }
+    if (aes128_eax_stream_final(&es, tag) == 0) {
+        puts("EAX stream second final accepted: FAILED");
+        failed = 1;
+    }
+
+    return failed;
 }
 
 /* ================================================================
@@ -748,7 +1111,124 @@ static int ccm_test(void)
     printf("CCM #14 decrypt: %s\n",
            memcmp(dec, ccm_pt_14, sizeof ccm_pt_14) ? "FAILED" : "OK");
 
-    return 0;
+    /* Keyed context: both vectors under one key schedule, in place */
+    aes128_ccm_ctx cc;
+    int bad = aes128_ccm_init(&cc, ccm_key_13, sizeof ccm_key_13) != 0;
+    bad |= aes128_ccm_encrypt_ctx(&cc, ccm_nonce_13, sizeof ccm_nonce_13, ccm_aad_13, sizeof ccm_aad_13,
+                                  ccm_pt_13, sizeof ccm_pt_13, out, tag, sizeof ccm_tag_13) != 0;
+    bad |= memcmp(out, ccm_ct_13, sizeof ccm_ct_13) || memcmp(tag, ccm_tag_13, sizeof ccm_tag_13);
+    bad |= aes128_ccm_init(&cc, ccm_key_14, sizeof ccm_key_14) != 0;
+    memcpy(dec, ccm_ct_14, sizeof ccm_ct_14);
+    bad |= aes128_ccm_decrypt_ctx(&cc, ccm_nonce_14, sizeof ccm_nonce_14, ccm_aad_14, sizeof ccm_aad_14,
+                                  dec, sizeof ccm_ct_14, ccm_tag_14, sizeof ccm_tag_14, dec) != 0;
+    bad |= memcmp(dec, ccm_pt_14, sizeof ccm_pt_14) != 0;
+    memcpy(dec, ccm_ct_14, sizeof ccm_ct_14);
+    dec[23] ^= 1;
+    bad |= aes128_ccm_decrypt_ctx(&cc, ccm_nonce_14, sizeof ccm_nonce_14, ccm_aad_14, sizeof ccm_aad_14,
+                                  dec, sizeof ccm_ct_14, ccm_tag_14, sizeof ccm_tag_14, dec) == 0;
+    bad |= aes128_ccm_init(&cc, ccm_key_14, 32) == 0;
+    printf("CCM keyed context: %s\n", bad ? "FAILED" : "OK");
+
+    return bad;
+}
+
+static int ccm_batch_test(void)
+{
+    puts("\n**** AES-128 CCM batch Test ****\n");
+
+    enum { N = 9 };
+    static const uint32_t lens[N] = { 23, 24, 0, 1, 16, 23, 64, 200, 700 };
+    static const uint32_t aad_lens[N] = { 8, 8, 0, 8, 14, 15, 0, 40, 300 };
+    static uint8_t pt[700], aad[300], ct[N][700], dec[N][700];
+    uint8_t nonce[13], ref[700], ref_tag[16], tags[N][16];
+    aes128_ccm_msg m[N];
+    aes128_ccm_ctx cc;
+    int failed = 0, vec_failed, mixed_failed = 0;
+
+    /* Packets #13 and #14 of RFC 3610 share a key; the other messages
+       mix lengths, nonce and tag sizes under it, more messages than
+       lanes, and message 5 has an invalid tag length */
+    fill_random(nonce, sizeof nonce);
+    fill_random(pt, sizeof pt);
+    fill_random(aad, sizeof aad);
+    if (aes128_ccm_init(&cc, ccm_key_13, sizeof ccm_key_13) != 0) {
+        puts("CCM batch init failed.");
+        return 1;
+    }
+    for (int i = 0; i < N; i++) {
+        m[i].nonce = nonce;
+        m[i].nonce_len = 5 + (uint32_t)i;
+        m[i].aad = aad;
+        m[i].aad_len = aad_lens[i];
+        m[i].in = pt;
+        m[i].out = ct[i];
+        m[i].len = lens[i];
+        m[i].tag = tags[i];
+        m[i].tag_len = i == 5 ? 5 : 16 - 2 * (uint32_t)(i % 3);
+    }
+    m[0].nonce = ccm_nonce_13;
+    m[0].nonce_len = sizeof ccm_nonce_13;
+    m[0].aad = ccm_aad_13;
+    m[0].in = ccm_pt_13;
+    m[0].tag_len = sizeof ccm_tag_13;
+    m[1].nonce = ccm_nonce_14;
+    m[1].nonce_len = sizeof ccm_nonce_14;
+    m[1].aad = ccm_aad_14;
+    m[1].in = ccm_pt_14;
+    m[1].tag_len = sizeof ccm_tag_14;
+
+    if (aes128_ccm_encrypt_batch(&cc, m, N) != -1) {
+        puts("CCM batch encrypt should report the invalid message: FAILED");
+        failed = 1;
+    }
+    vec_failed = m[0].status || memcmp(ct[0], ccm_ct_13, sizeof ccm_ct_13) ||
+                 memcmp(tags[0], ccm_tag_13, sizeof ccm_tag_13);
+    printf("CCM batch #13: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+    vec_failed = m[1].status || memcmp(ct[1], ccm_ct_14, sizeof ccm_ct_14) ||
+                 memcmp(tags[1], ccm_tag_14, sizeof ccm_tag_14);
+    printf("CCM batch #14: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    for (int i = 2; i < N; i++) {
+        if (i == 5) {
+            mixed_failed |= m[i].status != -1;
+            continue;
+        }
+        aes128_ccm_encrypt_ctx(&cc, nonce, m[i].nonce_len, aad, aad_lens[i], pt, lens[i],
+                               ref, ref_tag, m[i].tag_len);
+        if (m[i].status || memcmp(ct[i], ref, lens[i]) || memcmp(tags[i], ref_tag, m[i].tag_len)) {
+            mixed_failed = 1;
+        }
+    }
+    printf("CCM batch against single messages: %s\n", mixed_failed ? "FAILED" : "OK");
+    failed |= mixed_failed;
+
+    /* Decrypt in place with one tampered tag: only that message fails
+       and has its output zeroed */
+    m[5].tag_len = 8;
+    aes128_ccm_encrypt_ctx(&cc, nonce, m[5].nonce_len, aad, aad_lens[5], pt, lens[5], ct[5], tags[5], 8);
+    tags[7][0] ^= 1;
+    for (int i = 0; i < N; i++) {
+        memcpy(dec[i], ct[i], lens[i]);
+        m[i].in = dec[i];
+        m[i].out = dec[i];
+    }
+    mixed_failed = aes128_ccm_decrypt_batch(&cc, m, N) != -1;
+    mixed_failed |= m[0].status || memcmp(dec[0], ccm_pt_13, sizeof ccm_pt_13);
+    mixed_failed |= m[1].status || memcmp(dec[1], ccm_pt_14, sizeof ccm_pt_14);
+    for (int i = 2; i < N; i++) {
+        if (i == 7) {
+            mixed_failed |= m[i].status != -1;
+            for (uint32_t j = 0; j < lens[i]; j++) mixed_failed |= dec[i][j] != 0;
+        } else {
+            mixed_failed |= m[i].status != 0 || memcmp(dec[i], pt, lens[i]);
+        }
+    }
+    printf("CCM batch decrypt, one tampered tag: %s\n", mixed_failed ? "FAILED" : "OK");
+    failed |= mixed_failed;
+
+    return failed;
 }
 
 /* ================================================================
@@ -832,7 +1312,28 @@ static int gcm_siv_test(void)
     printf("GCM-SIV #2 decrypt: %s\n",
            memcmp(dec, gcm_siv_pt2, sizeof gcm_siv_pt2) ? "FAILED" : "OK");
 
-    return 0;
+    /* Keyed context: TC2 twice, then TC1, under one key schedule */
+    aes128_gcm_siv_ctx sc;
+    int bad = aes128_gcm_siv_init(&sc, gcm_siv_key2, sizeof gcm_siv_key2) != 0;
+    for (int i = 0; i < 2; i++) {
+        bad |= aes128_gcm_siv_encrypt_ctx(&sc, gcm_siv_nonce2, sizeof gcm_siv_nonce2, NULL, 0,
+                                          gcm_siv_pt2, sizeof gcm_siv_pt2, out, tag) != 0;
+        bad |= memcmp(out, gcm_siv_ct2, sizeof gcm_siv_ct2) || memcmp(tag, gcm_siv_tag2, AES_BLK_LEN);
+        bad |= aes128_gcm_siv_decrypt_ctx(&sc, gcm_siv_nonce2, sizeof gcm_siv_nonce2, NULL, 0,
+                                          out, sizeof gcm_siv_ct2, tag, dec) != 0;
+        bad |= memcmp(dec, gcm_siv_pt2, sizeof gcm_siv_pt2) != 0;
+    }
+    bad |= aes128_gcm_siv_init(&sc, gcm_siv_key1, sizeof gcm_siv_key1) != 0;
+    bad |= aes128_gcm_siv_encrypt_ctx(&sc, gcm_siv_nonce1, sizeof gcm_siv_nonce1, NULL, 0,
+                                      gcm_siv_pt1, 0, out, tag) != 0;
+    bad |= memcmp(tag, gcm_siv_tag1, AES_BLK_LEN) != 0;
+    tag[3] ^= 4;
+    bad |= aes128_gcm_siv_decrypt_ctx(&sc, gcm_siv_nonce1, sizeof gcm_siv_nonce1, NULL, 0,
+                                      gcm_siv_ct1, 0, tag, dec) == 0;
+    bad |= aes128_gcm_siv_init(&sc, gcm_siv_key1, 24) == 0;
+    printf("GCM-SIV keyed context: %s\n", bad ? "FAILED" : "OK");
+
+    return bad;
 }
 
 /* ================================================================
@@ -909,7 +1410,577 @@ static int gcm_test(void)
     print_hex("Decrypted ", decoded, plaintext_len);
     puts(!memcmp(decoded, plaintext, plaintext_len)
          ? "GCM: OK" : "GCM: FAILED");
-    return 0;
+
+    /* Keyed context: one setup, several messages, same results */
+    aes128_gcm_ctx gc;
+    uint8_t ct2[80], tag2[16];
+    int bad = aes128_gcm_init(&gc, key, sizeof key) != 0;
+    for (int i = 0; i < 3 && !bad; i++) {
+        memset(ct2, 0, sizeof ct2);
+        memset(decoded, 0, sizeof decoded);
+        bad |= aes128_gcm_encrypt_ctx(&gc, iv, sizeof iv, plaintext, (uint32_t)plaintext_len,
+                                      aad, sizeof aad, ct2, tag2) != 0;
+        bad |= memcmp(ct2, ciphertext, plaintext_len) || memcmp(tag2, expected_tag, sizeof tag2);
+        bad |= aes128_gcm_decrypt_ctx(&gc, iv, sizeof iv, ct2, (uint32_t)plaintext_len,
+                                      aad, sizeof aad, tag2, decoded) != 0;
+        bad |= memcmp(decoded, plaintext, plaintext_len) != 0;
+    }
+    tag2[0] ^= 1;
+    bad |= aes128_gcm_decrypt_ctx(&gc, iv, sizeof iv, ct2, (uint32_t)plaintext_len,
+                                  aad, sizeof aad, tag2, decoded) == 0;
+    for (size_t i = 0; i < plaintext_len; i++) {
+        bad |= decoded[i] != 0;
+    }
+    bad |= aes128_gcm_init(&gc, key, 15) == 0;
+    printf("GCM keyed context: %s\n", bad ? "FAILED" : "OK");
+    return bad;
+}
+
+/* Test cases 1-6 of McGrew and Viega, "The Galois/Counter Mode of
+   Operation (GCM)". Cases 1 and 2 use an all-zero key, IV and message;
+   cases 4-6 take the first 60 bytes of gcm_tc_pt with gcm_tc_aad, under
+   a 12, an 8 and a 60-byte IV. Case 4's ciphertext is case 3's, cut. */
+typedef struct {
+    const uint8_t *key;
+    const uint8_t *iv;
+    uint32_t iv_len;
+    const uint8_t *aad;
+    uint32_t aad_len;
+    const uint8_t *pt;
+    const uint8_t *ct;
+    uint32_t len;
+    const uint8_t *tag;
+} gcm_vec;
+
+static const uint8_t gcm_tc_zero[16];
+static const uint8_t gcm_tc_key[16] = {
+    0xfe,0xff,0xe9,0x92,0x86,0x65,0x73,0x1c,0x6d,0x6a,0x8f,0x94,0x67,0x30,0x83,0x08
+};
+static const uint8_t gcm_tc_iv[12] = {
+    0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,0xde,0xca,0xf8,0x88
+};
+static const uint8_t gcm_tc_iv60[60] = {
+    0x93,0x13,0x22,0x5d,0xf8,0x84,0x06,0xe5,0x55,0x90,0x9c,0x5a,0xff,0x52,0x69,0xaa,
+    0x6a,0x7a,0x95,0x38,0x53,0x4f,0x7d,0xa1,0xe4,0xc3,0x03,0xd2,0xa3,0x18,0xa7,0x28,
+    0xc3,0xc0,0xc9,0x51,0x56,0x80,0x95,0x39,0xfc,0xf0,0xe2,0x42,0x9a,0x6b,0x52,0x54,
+    0x16,0xae,0xdb,0xf5,0xa0,0xde,0x6a,0x57,0xa6,0x37,0xb3,0x9b
+};
+static const uint8_t gcm_tc_aad[20] = {
+    0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,
+    0xab,0xad,0xda,0xd2
+};
+static const uint8_t gcm_tc_pt[64] = {
+    0xd9,0x31,0x32,0x25,0xf8,0x84,0x06,0xe5,0xa5,0x59,0x09,0xc5,0xaf,0xf5,0x26,0x9a,
+    0x86,0xa7,0xa9,0x53,0x15,0x34,0xf7,0xda,0x2e,0x4c,0x30,0x3d,0x8a,0x31,0x8a,0x72,
+    0x1c,0x3c,0x0c,0x95,0x95,0x68,0x09,0x53,0x2f,0xcf,0x0e,0x24,0x49,0xa6,0xb5,0x25,
+    0xb1,0x6a,0xed,0xf5,0xaa,0x0d,0xe6,0x57,0xba,0x63,0x7b,0x39,0x1a,0xaf,0xd2,0x55
+};
+static const uint8_t gcm_tc_ct2[16] = {
+    0x03,0x88,0xda,0xce,0x60,0xb6,0xa3,0x92,0xf3,0x28,0xc2,0xb9,0x71,0xb2,0xfe,0x78
+};
+static const uint8_t gcm_tc_ct3[64] = {
+    0x42,0x83,0x1e,0xc2,0x21,0x77,0x74,0x24,0x4b,0x72,0x21,0xb7,0x84,0xd0,0xd4,0x9c,
+    0xe3,0xaa,0x21,0x2f,0x2c,0x02,0xa4,0xe0,0x35,0xc1,0x7e,0x23,0x29,0xac,0xa1,0x2e,
+    0x21,0xd5,0x14,0xb2,0x54,0x66,0x93,0x1c,0x7d,0x8f,0x6a,0x5a,0xac,0x84,0xaa,0x05,
+    0x1b,0xa3,0x0b,0x39,0x6a,0x0a,0xac,0x97,0x3d,0x58,0xe0,0x91,0x47,0x3f,0x59,0x85
+};
+static const uint8_t gcm_tc_ct5[60] = {
+    0x61,0x35,0x3b,0x4c,0x28,0x06,0x93,0x4a,0x77,0x7f,0xf5,0x1f,0xa2,0x2a,0x47,0x55,
+    0x69,0x9b,0x2a,0x71,0x4f,0xcd,0xc6,0xf8,0x37,0x66,0xe5,0xf9,0x7b,0x6c,0x74,0x23,
+    0x73,0x80,0x69,0x00,0xe4,0x9f,0x24,0xb2,0x2b,0x09,0x75,0x44,0xd4,0x89,0x6b,0x42,
+    0x49,0x89,0xb5,0xe1,0xeb,0xac,0x0f,0x07,0xc2,0x3f,0x45,0x98
+};
+static const uint8_t gcm_tc_ct6[60] = {
+    0x8c,0xe2,0x49,0x98,0x62,0x56,0x15,0xb6,0x03,0xa0,0x33,0xac,0xa1,0x3f,0xb8,0x94,
+    0xbe,0x91,0x12,0xa5,0xc3,0xa2,0x11,0xa8,0xba,0x26,0x2a,0x3c,0xca,0x7e,0x2c,0xa7,
+    0x01,0xe4,0xa9,0xa4,0xfb,0xa4,0x3c,0x90,0xcc,0xdc,0xb2,0x81,0xd4,0x8c,0x7c,0x6f,
+    0xd6,0x28,0x75,0xd2,0xac,0xa4,0x17,0x03,0x4c,0x34,0xae,0xe5
+};
+static const uint8_t gcm_tc_tag[6][16] = {
+    {0x58,0xe2,0xfc,0xce,0xfa,0x7e,0x30,0x61,0x36,0x7f,0x1d,0x57,0xa4,0xe7,0x45,0x5a},
+    {0xab,0x6e,0x47,0xd4,0x2c,0xec,0x13,0xbd,0xf5,0x3a,0x67,0xb2,0x12,0x57,0xbd,0xdf},
+    {0x4d,0x5c,0x2a,0xf3,0x27,0xcd,0x64,0xa6,0x2c,0xf3,0x5a,0xbd,0x2b,0xa6,0xfa,0xb4},
+    {0x5b,0xc9,0x4f,0xbc,0x32,0x21,0xa5,0xdb,0x94,0xfa,0xe9,0x5a,0xe7,0x12,0x1a,0x47},
+    {0x36,0x12,0xd2,0xe7,0x9e,0x3b,0x07,0x85,0x56,0x1b,0xe1,0x4a,0xac,0xa2,0xfc,0xcb},
+    {0x61,0x9c,0xc5,0xae,0xff,0xfe,0x0b,0xfa,0x46,0x2a,0xf4,0x3c,0x16,0x99,0xd0,0x50}
+};
+
+static const gcm_vec gcm_vecs[6] = {
+    {gcm_tc_zero, gcm_tc_zero, 12, NULL, 0, NULL, NULL, 0, gcm_tc_tag[0]},
+    {gcm_tc_zero, gcm_tc_zero, 12, NULL, 0, gcm_tc_zero, gcm_tc_ct2, 16, gcm_tc_tag[1]},
+    {gcm_tc_key, gcm_tc_iv, 12, NULL, 0, gcm_tc_pt, gcm_tc_ct3, 64, gcm_tc_tag[2]},
+    {gcm_tc_key, gcm_tc_iv, 12, gcm_tc_aad, 20, gcm_tc_pt, gcm_tc_ct3, 60, gcm_tc_tag[3]},
+    {gcm_tc_key, gcm_tc_iv, 8, gcm_tc_aad, 20, gcm_tc_pt, gcm_tc_ct5, 60, gcm_tc_tag[4]},
+    {gcm_tc_key, gcm_tc_iv60, 60, gcm_tc_aad, 20, gcm_tc_pt, gcm_tc_ct6, 60, gcm_tc_tag[5]},
+};
+
+/* NIST CAVP gcmEncryptExtIV128.rsp, Keylen 128, IVlen 96, PTlen 0,
+   AADlen 128, Count 0: a GMAC over one block */
+static const uint8_t gmac_key[16] = {
+    0x77,0xbe,0x63,0x70,0x89,0x71,0xc4,0xe2,0x40,0xd1,0xcb,0x79,0xe8,0xd7,0x7f,0xeb
+};
+static const uint8_t gmac_iv[12] = {
+    0xe0,0xe0,0x0f,0x19,0xfe,0xd7,0xba,0x01,0x36,0xa7,0x97,0xf3
+};
+static const uint8_t gmac_aad[16] = {
+    0x7a,0x43,0xec,0x1d,0x9c,0x0a,0x5a,0x78,0xa0,0xb1,0x65,0x33,0xa6,0x21,0x3c,0xab
+};
+static const uint8_t gmac_tag[16] = {
+    0x20,0x9f,0xcc,0x8d,0x36,0x75,0xed,0x93,0x8e,0x9c,0x71,0x66,0x70,0x9d,0xd9,0x46
+};
+
+
+/* GHASH/POLYVAL over more blocks than the multiply engines fold at
+   once, with a 60-byte GCM IV; tags from an independent GCM and
+   GCM-SIV implementation over the data gf_long_test() generates. */
+static const uint8_t gf_long_gcm_tag[16] = {
+    0xfe,0xb9,0x7e,0x32,0xe9,0x82,0x81,0x69,
+    0x05,0x49,0x80,0xfd,0x26,0x4c,0x9d,0x30
+};
+static const uint8_t gf_long_siv_tag[16] = {
+    0x7f,0x1c,0xcd,0x5e,0x52,0xd4,0x56,0xad,
+    0xf7,0x47,0x6d,0x32,0x48,0x88,0x9b,0xe6
+};
+
+static int gf_long_test(void)
+{
+    puts("\n**** GHASH / POLYVAL long-input Test ****\n");
+
+    uint8_t key[16], iv[60], pt[200], aad[40], ct[200], dec[200], tag[16];
+    int failed = 0, vec_failed;
+
+    /* Reseeded, so the data behind the tags above does not depend on
+       the tests that ran first */
+    prng_state = 0x2545f491U;
+    fill_random(key, sizeof key);
+    fill_random(iv, sizeof iv);
+    fill_random(aad, sizeof aad);
+    fill_random(pt, sizeof pt);
+
+    vec_failed = aes128_gcm_encrypt(key, 16, iv, 60, pt, 200, aad, 40, ct, tag) != 0;
+    print_hex("Tag       ", tag, sizeof tag);
+    vec_failed |= memcmp(tag, gf_long_gcm_tag, 16) != 0;
+    vec_failed |= aes128_gcm_decrypt(key, 16, iv, 60, ct, 200, aad, 40, tag, dec) != 0 ||
+                  memcmp(dec, pt, 200) != 0;
+    printf("GCM 200-byte, 60-byte IV: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    vec_failed = aes128_gcm_siv_encrypt(key, 16, iv, 12, aad, 40, pt, 200, ct, tag) != 0;
+    print_hex("Tag       ", tag, sizeof tag);
+    vec_failed |= memcmp(tag, gf_long_siv_tag, 16) != 0;
+    vec_failed |= aes128_gcm_siv_decrypt(key, 16, iv, 12, aad, 40, ct, 200, tag, dec) != 0 ||
+                  memcmp(dec, pt, 200) != 0;
+    printf("GCM-SIV 200-byte: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* Lengths past the standards' limits are refused before any data is
+       touched; only meaningful where size_t can express them. */
+    if (sizeof(size_t) > 4) {
+        size_t big = (size_t)((uint64_t)1 << 36);
+        vec_failed = aes128_gcm_encrypt(key, 16, iv, 12, NULL, big, NULL, 0, NULL, tag) == 0 ||
+                     aes128_gcm_siv_encrypt(key, 16, iv, 12, NULL, big + 1, NULL, 0, NULL, tag) == 0 ||
+                     aes128_gcm_siv_decrypt(key, 16, iv, 12, NULL, 0, NULL, big + 1, tag, NULL) == 0;
+        printf("GCM/GCM-SIV length limits: %s\n", vec_failed ? "FAILED" : "OK");
+        failed |= vec_failed;
+    }
+
+    return failed;
+}
+
+/* Streaming GCM must match the one-shot call for any chunking. */
+static int gcm_stream_test(void)
+{
+    puts("\n**** AES-128 GCM streaming Test ****\n");
+
+    static const uint32_t chunks[] = { 1, 15, 16, 17, 3, 64, 5, 200 };
+    uint8_t key[16], iv[60], pt[200], aad[40], ref[200], ref_tag[16];
+    uint8_t ct[200], dec[200], tag[16];
+    aes128_gcm_ctx gc;
+    aes128_gcm_stream gs;
+    int failed = 0;
+
+    /* Published cases, the AAD in one call and the message 7 bytes at a
+       time, then decrypted in place in one call */
+    for (size_t i = 0; i < sizeof gcm_vecs / sizeof gcm_vecs[0]; i++) {
+        const gcm_vec *v = &gcm_vecs[i];
+        int vec_failed;
+
+        aes128_gcm_init(&gc, v->key, 16);
+        aes128_gcm_stream_init(&gs, &gc, v->iv, v->iv_len);
+        aes128_gcm_stream_aad(&gs, v->aad, v->aad_len);
+        for (uint32_t off = 0; off < v->len; off += 7) {
+            aes128_gcm_stream_encrypt(&gs, v->pt + off, ct + off, v->len - off < 7 ? v->len - off : 7);
+        }
+        vec_failed = aes128_gcm_stream_final(&gs, tag) != 0 || memcmp(tag, v->tag, 16) ||
+                     (v->len && memcmp(ct, v->ct, v->len));
+
+        aes128_gcm_stream_init(&gs, &gc, v->iv, v->iv_len);
+        aes128_gcm_stream_aad(&gs, v->aad, v->aad_len);
+        aes128_gcm_stream_decrypt(&gs, ct, ct, v->len);
+        vec_failed |= aes128_gcm_stream_verify(&gs, v->tag) != 0 || (v->len && memcmp(ct, v->pt, v->len));
+        printf("GCM stream TC%zu: %s\n", i + 1, vec_failed ? "FAILED" : "OK");
+        failed |= vec_failed;
+    }
+
+    /* Longer input against the one-shot call, in eight chunk sizes */
+    fill_random(key, sizeof key);
+    fill_random(iv, sizeof iv);
+    fill_random(aad, sizeof aad);
+    fill_random(pt, sizeof pt);
+    aes128_gcm_init(&gc, key, sizeof key);
+    aes128_gcm_encrypt_ctx(&gc, iv, 60, pt, 200, aad, 40, ref, ref_tag);
+
+    for (uint32_t c = 0; c < sizeof chunks / sizeof chunks[0]; c++) {
+        uint32_t step = chunks[c], off;
+        int chunk_failed = 0;
+
+        aes128_gcm_stream_init(&gs, &gc, iv, 60);
+        for (off = 0; off < 40; off += step) {
+            aes128_gcm_stream_aad(&gs, aad + off, 40 - off < step ? 40 - off : step);
+        }
+        for (off = 0; off < 200; off += step) {
+            aes128_gcm_stream_encrypt(&gs, pt + off, ct + off, 200 - off < step ? 200 - off : step);
+        }
+        if (aes128_gcm_stream_aad(&gs, aad, 1) == 0) {
+            chunk_failed = 1;    /* AAD after data */
+        }
+        if (aes128_gcm_stream_final(&gs, tag) || memcmp(ct, ref, 200) || memcmp(tag, ref_tag, 16)) {
+            chunk_failed = 1;
+        }
+
+        /* Decrypt in place, one byte more per chunk */
+        memcpy(dec, ct, 200);
+        aes128_gcm_stream_init(&gs, &gc, iv, 60);
+        aes128_gcm_stream_aad(&gs, aad, 40);
+        for (off = 0; off < 200; off += step + 1) {
+            aes128_gcm_stream_decrypt(&gs, dec + off, dec + off, 200 - off < step + 1 ? 200 - off : step + 1);
+        }
+        if (aes128_gcm_stream_verify(&gs, tag) != 0 || memcmp(dec, pt, 200)) {
+            chunk_failed = 1;
+        }
+        printf("GCM stream %u-byte chunks: %s\n", step, chunk_failed ? "FAILED" : "OK");
+        failed |= chunk_failed;
+    }
+
+    /* Empty AAD and data calls with NULL pointers, with and without a
+       partial block pending */
+    aes128_gcm_stream_init(&gs, &gc, iv, 60);
+    aes128_gcm_stream_aad(&gs, NULL, 0);
+    aes128_gcm_stream_aad(&gs, aad, 5);
+    aes128_gcm_stream_aad(&gs, NULL, 0);
+    aes128_gcm_stream_aad(&gs, aad + 5, 35);
+    aes128_gcm_stream_encrypt(&gs, NULL, NULL, 0);
+    aes128_gcm_stream_encrypt(&gs, pt, ct, 21);
+    aes128_gcm_stream_encrypt(&gs, NULL, NULL, 0);
+    aes128_gcm_stream_encrypt(&gs, pt + 21, ct + 21, 179);
+    if (aes128_gcm_stream_final(&gs, tag) || memcmp(ct, ref, 200) || memcmp(tag, ref_tag, 16)) {
+        puts("GCM stream empty calls: FAILED");
+        failed = 1;
+    } else {
+        puts("GCM stream empty calls: OK");
+    }
+
+    /* A tampered tag; a second final */
+    aes128_gcm_stream_init(&gs, &gc, iv, 60);
+    aes128_gcm_stream_aad(&gs, aad, 40);
+    aes128_gcm_stream_decrypt(&gs, ref, dec, 200);
+    tag[15] ^= 0x80;
+    if (aes128_gcm_stream_verify(&gs, tag) == 0) {
+        puts("GCM stream tampered tag accepted: FAILED");
+        failed = 1;
+    }
+    aes128_gcm_stream_init(&gs, &gc, iv, 12);
+    aes128_gcm_stream_final(&gs, tag);
+    if (aes128_gcm_stream_final(&gs, tag) == 0) {
+        puts("GCM stream second final accepted: FAILED");
+        failed = 1;
+    }
+
+    return failed;
+}
+
+static int gcm_batch_test(void)
+{
+    puts("\n**** AES-128 GCM batch Test ****\n");
+
+    enum { N = 10, NV = sizeof gcm_vecs / sizeof gcm_vecs[0] };
+    static const size_t lens[N] = { 0, 1, 15, 16, 64, 127, 128, 255, 1040, 1500 };
+    static uint8_t pt[1500], ct[N][1500], dec[N][1500];
+    uint8_t key[16], iv[60], aad[48], ref[1500], ref_tag[16], tags[N][16];
+    aes128_gcm_msg m[N];
+    aes128_gcm_ctx gc;
+    int failed = 0, mixed_failed = 0, vec_failed[NV];
+
+    /* Published cases, sealed and opened in place a key at a time:
+       cases 1-2 share the zero key, 3-6 one group of four */
+    for (size_t first = 0; first < NV; ) {
+        size_t n = 0;
+
+        aes128_gcm_init(&gc, gcm_vecs[first].key, 16);
+        for (; first + n < NV && gcm_vecs[first + n].key == gcm_vecs[first].key; n++) {
+            const gcm_vec *v = &gcm_vecs[first + n];
+            m[n].iv = v->iv;
+            m[n].iv_len = v->iv_len;
+            m[n].aad = v->aad;
+            m[n].aad_len = v->aad_len;
+            m[n].in = v->pt;
+            m[n].out = ct[n];
+            m[n].len = v->len;
+            m[n].tag = tags[n];
+        }
+        aes128_gcm_encrypt_batch(&gc, m, n);
+        for (size_t i = 0; i < n; i++) {
+            const gcm_vec *v = &gcm_vecs[first + i];
+            vec_failed[i] = m[i].status != 0 || memcmp(tags[i], v->tag, 16) ||
+                            (v->len && memcmp(ct[i], v->ct, v->len));
+            m[i].in = ct[i];
+        }
+        aes128_gcm_decrypt_batch(&gc, m, n);
+        for (size_t i = 0; i < n; i++) {
+            const gcm_vec *v = &gcm_vecs[first + i];
+            vec_failed[i] |= m[i].status != 0 || (v->len && memcmp(ct[i], v->pt, v->len));
+            printf("GCM batch TC%zu: %s\n", first + i + 1, vec_failed[i] ? "FAILED" : "OK");
+            failed |= vec_failed[i];
+        }
+        first += n;
+    }
+
+    /* Mixed lengths, IV sizes and AAD, each checked against the
+       single-message path */
+    fill_random(key, sizeof key);
+    fill_random(iv, sizeof iv);
+    fill_random(aad, sizeof aad);
+    fill_random(pt, sizeof pt);
+    aes128_gcm_init(&gc, key, sizeof key);
+    for (int i = 0; i < N; i++) {
+        m[i].iv = iv + i;
+        m[i].iv_len = i & 1 ? 12 : 60 - (uint32_t)i;
+        m[i].aad = aad;
+        m[i].aad_len = (size_t)(i * 5);
+        m[i].in = pt;
+        m[i].out = ct[i];
+        m[i].len = lens[i];
+        m[i].tag = tags[i];
+    }
+    mixed_failed = aes128_gcm_encrypt_batch(&gc, m, N) != 0;
+    for (int i = 0; i < N; i++) {
+        aes128_gcm_encrypt_ctx(&gc, m[i].iv, m[i].iv_len, pt, lens[i], aad, m[i].aad_len, ref, ref_tag);
+        if (m[i].status != 0 || memcmp(ct[i], ref, lens[i]) || memcmp(tags[i], ref_tag, 16)) {
+            mixed_failed = 1;
+        }
+    }
+    printf("GCM batch against single messages: %s\n", mixed_failed ? "FAILED" : "OK");
+    failed |= mixed_failed;
+
+    /* Decrypt in place with one tampered tag: only that message fails
+       and has its output zeroed */
+    tags[4][0] ^= 1;
+    for (int i = 0; i < N; i++) {
+        memcpy(dec[i], ct[i], lens[i]);
+        m[i].in = dec[i];
+        m[i].out = dec[i];
+    }
+    mixed_failed = aes128_gcm_decrypt_batch(&gc, m, N) != -1;
+    for (int i = 0; i < N; i++) {
+        if (i == 4) {
+            mixed_failed |= m[i].status != -1;
+            for (size_t j = 0; j < lens[i]; j++) mixed_failed |= dec[i][j] != 0;
+        } else {
+            mixed_failed |= m[i].status != 0 || memcmp(dec[i], pt, lens[i]);
+        }
+    }
+    printf("GCM batch decrypt, one tampered tag: %s\n", mixed_failed ? "FAILED" : "OK");
+    failed |= mixed_failed;
+
+    /* An over-limit length in the middle of a group fails alone */
+    if (sizeof(size_t) > 4) {
+        for (int i = 0; i < N; i++) {
+            m[i].in = pt;
+            m[i].out = ct[i];
+        }
+        m[5].len = (size_t)((uint64_t)1 << 36);
+        mixed_failed = aes128_gcm_encrypt_batch(&gc, m, N) != -1;
+        for (int i = 0; i < N; i++) {
+            mixed_failed |= m[i].status != (i == 5 ? -1 : 0);
+        }
+        printf("GCM batch over-limit length: %s\n", mixed_failed ? "FAILED" : "OK");
+        failed |= mixed_failed;
+    }
+
+    return failed;
+}
+
+static int gcm_prefix_test(void)
+{
+    puts("\n**** AES-128 GCM AAD prefix Test ****\n");
+
+    const gcm_vec *tc4 = &gcm_vecs[3];
+    uint8_t key[16], iv[12], pt[100], aad[72], ref[100], ref_tag[16];
+    uint8_t ct[100], dec[100], tag[16];
+    aes128_gcm_prefix gp;
+    aes128_gcm_stream gs;
+    aes128_gcm_ctx gc;
+    int failed = 0, vec_failed;
+
+    /* Case 4 with its AAD split into a 16-byte prefix and a 4-byte suffix */
+    aes128_gcm_init(&gc, tc4->key, 16);
+    vec_failed = aes128_gcm_prefix_init(&gc, &gp, tc4->aad, 16) != 0;
+    vec_failed |= aes128_gcm_encrypt_prefix(&gc, &gp, tc4->iv, tc4->iv_len, tc4->pt, tc4->len,
+                                            tc4->aad + 16, 4, ct, tag) != 0;
+    print_hex("Tag       ", tag, sizeof tag);
+    vec_failed |= memcmp(ct, tc4->ct, tc4->len) || memcmp(tag, tc4->tag, 16);
+    vec_failed |= aes128_gcm_decrypt_prefix(&gc, &gp, tc4->iv, tc4->iv_len, tc4->ct, tc4->len,
+                                            tc4->aad + 16, 4, tc4->tag, dec) != 0 ||
+                  memcmp(dec, tc4->pt, tc4->len);
+    aes128_gcm_stream_init(&gs, &gc, tc4->iv, tc4->iv_len);
+    aes128_gcm_stream_prefix(&gs, &gp);
+    aes128_gcm_stream_aad(&gs, tc4->aad + 16, 4);
+    aes128_gcm_stream_encrypt(&gs, tc4->pt, ct, tc4->len);
+    vec_failed |= aes128_gcm_stream_final(&gs, tag) || memcmp(tag, tc4->tag, 16);
+    printf("GCM prefix TC4: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* A 48-byte prefix with suffixes of 0, 1 and 24 bytes must match the
+       whole AAD hashed from scratch */
+    fill_random(key, sizeof key);
+    fill_random(iv, sizeof iv);
+    fill_random(aad, sizeof aad);
+    fill_random(pt, sizeof pt);
+    aes128_gcm_init(&gc, key, sizeof key);
+    aes128_gcm_prefix_init(&gc, &gp, aad, 48);
+    for (size_t sfx = 0; sfx <= 24; sfx += sfx ? 23 : 1) {
+        aes128_gcm_encrypt_ctx(&gc, iv, 12, pt, 100, aad, 48 + sfx, ref, ref_tag);
+        vec_failed = aes128_gcm_encrypt_prefix(&gc, &gp, iv, 12, pt, 100, aad + 48, sfx, ct, tag) != 0 ||
+                     memcmp(ct, ref, 100) || memcmp(tag, ref_tag, 16);
+        vec_failed |= aes128_gcm_decrypt_prefix(&gc, &gp, iv, 12, ct, 100, aad + 48, sfx, tag, dec) != 0 ||
+                      memcmp(dec, pt, 100);
+
+        aes128_gcm_stream_init(&gs, &gc, iv, 12);
+        aes128_gcm_stream_prefix(&gs, &gp);
+        aes128_gcm_stream_aad(&gs, aad + 48, sfx);
+        aes128_gcm_stream_encrypt(&gs, pt, ct, 100);
+        vec_failed |= aes128_gcm_stream_final(&gs, tag) || memcmp(tag, ref_tag, 16);
+        printf("GCM prefix, %zu-byte suffix: %s\n", sfx, vec_failed ? "FAILED" : "OK");
+        failed |= vec_failed;
+    }
+
+    /* A wrong suffix fails; a suffix long enough to wrap prefix + suffix,
+       an unaligned prefix and a prefix after AAD are all refused */
+    vec_failed = aes128_gcm_decrypt_prefix(&gc, &gp, iv, 12, ref, 100, aad + 47, 24, ref_tag, dec) == 0;
+    if (sizeof(size_t) > 4) {
+        vec_failed |= aes128_gcm_encrypt_prefix(&gc, &gp, iv, 12, pt, 100, NULL, (size_t)-40, ct, tag) != -1;
+    }
+    vec_failed |= aes128_gcm_prefix_init(&gc, &gp, aad, 40) == 0;
+    aes128_gcm_stream_init(&gs, &gc, iv, 12);
+    aes128_gcm_stream_aad(&gs, aad, 16);
+    vec_failed |= aes128_gcm_stream_prefix(&gs, &gp) == 0;
+    printf("GCM prefix misuse rejected: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    return failed;
+}
+
+static int gmac_test(void)
+{
+    puts("\n**** AES-128 GMAC Test ****\n");
+
+    static const size_t lens[] = { 0, 1, 16, 17, 255, 4096 };
+    static const uint32_t threads[] = { 0, 1, 3, 8, 100 };
+    static uint8_t aad[(1 << 20) + 5];
+    uint8_t key[16], iv[12], ref_tag[16], tag[16];
+    aes128_gcm_ctx gc;
+    int failed = 0, vec_failed;
+
+    /* The CAVP vector, through the keyed, one-shot and threaded calls */
+    aes128_gcm_init(&gc, gmac_key, sizeof gmac_key);
+    vec_failed = aes128_gmac_ctx(&gc, gmac_iv, 12, gmac_aad, sizeof gmac_aad, tag) != 0;
+    print_hex("Tag       ", tag, sizeof tag);
+    vec_failed |= memcmp(tag, gmac_tag, 16) != 0;
+    vec_failed |= aes128_gmac(gmac_key, 16, gmac_iv, 12, gmac_aad, sizeof gmac_aad, tag) != 0 ||
+                  memcmp(tag, gmac_tag, 16);
+    vec_failed |= aes128_gmac_parallel(&gc, gmac_iv, 12, gmac_aad, sizeof gmac_aad, 4, tag) != 0 ||
+                  memcmp(tag, gmac_tag, 16);
+    printf("GMAC CAVP vector: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* Elsewhere GMAC is GCM with an empty plaintext */
+    fill_random(key, sizeof key);
+    fill_random(iv, sizeof iv);
+    fill_random(aad, sizeof aad);
+    aes128_gcm_init(&gc, key, sizeof key);
+    vec_failed = 0;
+    for (size_t i = 0; i < sizeof lens / sizeof lens[0]; i++) {
+        aes128_gcm_encrypt_ctx(&gc, iv, 12, NULL, 0, aad, lens[i], NULL, ref_tag);
+        vec_failed |= aes128_gmac_ctx(&gc, iv, 12, aad, lens[i], tag) || memcmp(tag, ref_tag, 16);
+        vec_failed |= aes128_gmac(key, 16, iv, 12, aad, lens[i], tag) || memcmp(tag, ref_tag, 16);
+    }
+    printf("GMAC against GCM: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* A 1 MiB + 5 byte input, split a few ways: the tag must not change */
+    aes128_gcm_encrypt_ctx(&gc, iv, 12, NULL, 0, aad, sizeof aad, NULL, ref_tag);
+    for (size_t i = 0; i < sizeof threads / sizeof threads[0]; i++) {
+        vec_failed = aes128_gmac_parallel(&gc, iv, 12, aad, sizeof aad, threads[i], tag) != 0 ||
+                     memcmp(tag, ref_tag, 16);
+        printf("GMAC 1 MiB, %u threads: %s\n", threads[i], vec_failed ? "FAILED" : "OK");
+        failed |= vec_failed;
+    }
+    if (aes128_gmac(key, 15, iv, 12, aad, 16, tag) == 0) {
+        puts("GMAC bad key length accepted: FAILED");
+        failed = 1;
+    }
+
+    return failed;
+}
+
+static int gcm_nonce_test(void)
+{
+    puts("\n**** AES-128 GCM nonce generator Test ****\n");
+
+    static const uint8_t fixed[4] = { 0xde, 0xad, 0xbe, 0xef };
+    static const uint8_t iv1[12] = { 0xde, 0xad, 0xbe, 0xef, 0, 0, 0, 0, 0, 0, 0, 1 };
+    uint8_t key[16], pt[50], ct[50], ref[50], iv[12], tag[16], ref_tag[16];
+    aes128_gcm_nonce gn;
+    aes128_gcm_nonce_range r1, r2;
+    aes128_gcm_ctx gc;
+    int failed = 0, vec_failed;
+
+    fill_random(key, sizeof key);
+    fill_random(pt, sizeof pt);
+    aes128_gcm_init(&gc, key, sizeof key);
+
+    /* fixed || counter, counting from zero; ranges follow on and do not
+       overlap; a reservation that does not fit leaves the rest usable */
+    vec_failed = aes128_gcm_nonce_init(&gn, &gc, fixed, 10) != 0;
+    vec_failed |= aes128_gcm_nonce_next(&gn, iv) != 0;
+    vec_failed |= aes128_gcm_nonce_next(&gn, iv) != 0 || memcmp(iv, iv1, 12);
+    vec_failed |= aes128_gcm_nonce_reserve(&gn, 3, &r1) != 0;
+    vec_failed |= aes128_gcm_nonce_reserve(&gn, 4, &r2) != 0;
+    vec_failed |= aes128_gcm_nonce_reserve(&gn, 2, &r2) == 0 || aes128_gcm_nonce_reserve(&gn, 0, &r2) == 0;
+    for (int i = 0; i < 3; i++) {
+        vec_failed |= aes128_gcm_nonce_range_next(&r1, iv) != 0 || iv[11] != 2 + i;
+    }
+    vec_failed |= aes128_gcm_nonce_range_next(&r1, iv) == 0;
+    vec_failed |= aes128_gcm_nonce_range_next(&r2, iv) != 0 || iv[11] != 5;
+    print_hex("IV        ", iv, sizeof iv);
+    printf("GCM nonce layout and ranges: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* Encrypting with the next IV matches the keyed API with that IV */
+    vec_failed = aes128_gcm_encrypt_next(&gn, pt, 50, NULL, 0, ct, iv, tag) != 0 || iv[11] != 9;
+    aes128_gcm_encrypt_ctx(&gc, iv, 12, pt, 50, NULL, 0, ref, ref_tag);
+    vec_failed |= memcmp(ct, ref, 50) || memcmp(tag, ref_tag, 16);
+    vec_failed |= aes128_gcm_encrypt_range(&r2, pt, 50, NULL, 0, ct, iv, tag) != 0 || iv[11] != 6;
+    printf("GCM encrypt with generated IVs: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* The limit is enforced */
+    vec_failed = aes128_gcm_nonce_next(&gn, iv) == 0;
+    vec_failed |= aes128_gcm_encrypt_next(&gn, pt, 50, NULL, 0, ct, iv, tag) == 0;
+    printf("GCM nonce limit: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    return failed;
 }
 
 /* ================================================================
@@ -977,25 +2048,6 @@ static const lightmac_vec lm_vecs[] = {
     {32, 128, lm_msg_00_0b,12,  lm_tag_s32_t128_00_0b, 16},
 };
 
-static uint32_t lm_prng_state = 0x6b8b4567U;
-
-static uint32_t lm_prng_next(void)
-{
-    uint32_t x = lm_prng_state;
-    x ^= x << 13;
-    x ^= x >> 17;
-    x ^= x << 5;
-    lm_prng_state = x;
-    return x;
-}
-
-static void lm_fill_random(uint8_t *buf, uint32_t len)
-{
-    for (uint32_t i = 0; i < len; ++i) {
-        buf[i] = (uint8_t)lm_prng_next();
-    }
-}
-
 static int lightmac_test(void)
 {
     puts("\n**** AES-128 LightMAC Test ****\n");
@@ -1119,18 +2171,18 @@ static int lightmac_tamper_fuzz_test(void)
     uint8_t tag[16];
     uint8_t tag_bad[16];
 
-    lm_fill_random(k1, sizeof k1);
-    lm_fill_random(k2, sizeof k2);
+    fill_random(k1, sizeof k1);
+    fill_random(k2, sizeof k2);
 
     int failed = 0;
     const uint8_t s_opts[] = {8, 16, 32, 64};
 
     for (uint32_t i = 0; i < 200; ++i) {
-        uint8_t s_bits = s_opts[lm_prng_next() & 3U];
-        uint8_t t_bits = (uint8_t)(((lm_prng_next() % 16U) + 1U) * 8U);
-        uint32_t msg_len = lm_prng_next() % (uint32_t)sizeof msg;
+        uint8_t s_bits = s_opts[prng_next() & 3U];
+        uint8_t t_bits = (uint8_t)(((prng_next() % 16U) + 1U) * 8U);
+        uint32_t msg_len = prng_next() % (uint32_t)sizeof msg;
 
-        lm_fill_random(msg, msg_len);
+        fill_random(msg, msg_len);
         memset(tag, 0, sizeof tag);
 
         if (aes128_lightmac(tag, k1, k2, s_bits, t_bits, msg, msg_len) != AES128_LIGHTMAC_OK) {
@@ -1154,7 +2206,7 @@ static int lightmac_tamper_fuzz_test(void)
         }
 
         if (msg_len > 0) {
-            uint32_t idx = lm_prng_next() % msg_len;
+            uint32_t idx = prng_next() % msg_len;
             msg[idx] ^= 0x01;
             vrc = aes128_lightmac_verify(tag, k1, k2, s_bits, t_bits, msg, msg_len);
             if (vrc != 0) {
@@ -1167,6 +2219,184 @@ static int lightmac_tamper_fuzz_test(void)
     return failed ? 1 : 0;
 }
 
+/* ================================================================
+ * 12. CMAC
+ * ================================================================*/
+/* RFC 4493 section 4: one key, prefixes of one 64-byte message */
+static const uint8_t cmac_key[16] = {
+    0x2b,0x7e,0x15,0x16,0x28,0xae,0xd2,0xa6,0xab,0xf7,0x15,0x88,0x09,0xcf,0x4f,0x3c
+};
+static const uint8_t cmac_msg[64] = {
+    0x6b,0xc1,0xbe,0xe2,0x2e,0x40,0x9f,0x96,0xe9,0x3d,0x7e,0x11,0x73,0x93,0x17,0x2a,
+    0xae,0x2d,0x8a,0x57,0x1e,0x03,0xac,0x9c,0x9e,0xb7,0x6f,0xac,0x45,0xaf,0x8e,0x51,
+    0x30,0xc8,0x1c,0x46,0xa3,0x5c,0xe4,0x11,0xe5,0xfb,0xc1,0x19,0x1a,0x0a,0x52,0xef,
+    0xf6,0x9f,0x24,0x45,0xdf,0x4f,0x9b,0x17,0xad,0x2b,0x41,0x7b,0xe6,0x6c,0x37,0x10
+};
+static const size_t cmac_lens[4] = { 0, 16, 40, 64 };
+static const uint8_t cmac_tags[4][16] = {
+    {0xbb,0x1d,0x69,0x29,0xe9,0x59,0x37,0x28,0x7f,0xa3,0x7d,0x12,0x9b,0x75,0x67,0x46},
+    {0x07,0x0a,0x16,0xb4,0x6b,0x4d,0x41,0x44,0xf7,0x9b,0xdd,0x9d,0xd0,0x4a,0x28,0x7c},
+    {0xdf,0xa6,0x67,0x47,0xde,0x9a,0xe6,0x30,0x30,0xca,0x32,0x61,0x14,0x97,0xc8,0x27},
+    {0x51,0xf0,0xbe,0xbf,0x7e,0x3b,0x9d,0x92,0xfc,0x49,0x74,0x17,0x79,0x36,0x3c,0xfe}
+};
+
+/* NIST SP 800-38B appendix D.3, AES-256: empty and 16-byte messages */
+static const uint8_t cmac_key256[32] = {
+    0x60,0x3d,0xeb,0x10,0x15,0xca,0x71,0xbe,0x2b,0x73,0xae,0xf0,0x85,0x7d,0x77,0x81,
+    0x1f,0x35,0x2c,0x07,0x3b,0x61,0x08,0xd7,0x2d,0x98,0x10,0xa3,0x09,0x14,0xdf,0xf4
+};
+static const uint8_t cmac_tags256[2][16] = {
+    {0x02,0x89,0x62,0xf6,0x1b,0x7b,0xf8,0x9e,0xfc,0x6b,0x55,0x1f,0x46,0x67,0xd9,0x83},
+    {0x28,0xa7,0x02,0x3f,0x45,0x2e,0x8f,0x82,0xbd,0x4b,0xf2,0x8d,0x8c,0x37,0xc3,0x5c}
+};
+
+static int cmac_test(void)
+{
+    puts("\n**** AES-128 CMAC Test ****\n");
+
+    aes128_cmac_ctx c;
+    aes128_cmac_stream s, t;
+    aes128_cmac_state st;
+    uint8_t tag[16];
+    int bad;
+
+    for (int i = 0; i < 4; i++) {
+        bad = aes128_cmac(cmac_key, sizeof cmac_key, cmac_msg, cmac_lens[i], tag) != 0 ||
+              memcmp(tag, cmac_tags[i], 16) != 0;
+        printf("CMAC #%d (%zu bytes): %s\n", i + 1, cmac_lens[i], bad ? "FAILED" : "OK");
+    }
+
+    bad = aes128_cmac_init(&c, cmac_key256, sizeof cmac_key256) != 0;
+    for (int i = 0; i < 2; i++) {
+        bad |= aes128_cmac_sign(&c, cmac_msg, (size_t)i * 16, tag) != 0 ||
+               memcmp(tag, cmac_tags256[i], 16) != 0;
+    }
+    bad |= aes128_cmac_init(&c, cmac_key256, 20) != -1;
+    printf("CMAC AES-256: %s\n", bad ? "FAILED" : "OK");
+
+    /* Streaming: every vector one byte at a time, with the tag taken
+       at each length along the way */
+    bad = aes128_cmac_init(&c, cmac_key, sizeof cmac_key) != 0;
+    aes128_cmac_stream_init(&s, &c);
+    for (size_t off = 0, i = 0; off <= 64; off++) {
+        if (off == cmac_lens[i]) {
+            bad |= aes128_cmac_stream_final(&s, tag) || memcmp(tag, cmac_tags[i], 16);
+            bad |= aes128_cmac_stream_verify(&s, cmac_tags[i], 16) != 0;
+            i++;
+        }
+        if (off < 64) {
+            bad |= aes128_cmac_stream_update(&s, cmac_msg + off, 1);
+        }
+    }
+
+    /* Snapshot after a 20-byte header, then two messages from it */
+    aes128_cmac_stream_init(&s, &c);
+    aes128_cmac_stream_update(&s, cmac_msg, 20);
+    aes128_cmac_stream_save(&s, &st);
+    aes128_cmac_stream_update(&s, cmac_msg + 20, 44);
+    bad |= aes128_cmac_stream_final(&s, tag) || memcmp(tag, cmac_tags[3], 16);
+    aes128_cmac_stream_restore(&t, &c, &st);
+    aes128_cmac_stream_update(&t, cmac_msg + 20, 20);
+    bad |= aes128_cmac_stream_final(&t, tag) || memcmp(tag, cmac_tags[2], 16);
+
+    /* Truncated tags; a flipped bit and bad lengths are rejected */
+    bad |= aes128_cmac_verify(&c, cmac_msg, 40, cmac_tags[2], 8) != 0;
+    memcpy(tag, cmac_tags[2], 16);
+    tag[7] ^= 1;
+    bad |= aes128_cmac_verify(&c, cmac_msg, 40, tag, 8) != -1;
+    bad |= aes128_cmac_verify(&c, cmac_msg, 40, cmac_tags[2], 0) != -1;
+    bad |= aes128_cmac_verify(&c, cmac_msg, 40, cmac_tags[2], 17) != -1;
+    printf("CMAC streaming and snapshot: %s\n", bad ? "FAILED" : "OK");
+
+    return bad;
+}
+
+static int cmac_batch_test(void)
+{
+    puts("\n**** AES-128 CMAC batch Test ****\n");
+
+    enum { N = 21 };
+    static uint8_t in[N][300], tags[N][16];
+    aes128_cmac_msg m[N];
+    aes128_cmac_ctx c;
+    aes128_cmac_stream s;
+    aes128_cmac_state hdr;
+    uint8_t ref[16];
+    int failed = 0, vec_failed;
+
+    /* The RFC 4493 and SP 800-38B examples, each set in one batch */
+    for (int k = 0; k < 2; k++) {
+        int n = k ? 2 : 4;
+
+        aes128_cmac_init(&c, k ? cmac_key256 : cmac_key, k ? sizeof cmac_key256 : sizeof cmac_key);
+        for (int i = 0; i < n; i++) {
+            m[i].prefix = NULL;
+            m[i].in = cmac_msg;
+            m[i].len = k ? (size_t)i * 16 : cmac_lens[i];
+            m[i].tag = tags[i];
+            m[i].tag_len = 16;
+        }
+        vec_failed = aes128_cmac_sign_batch(&c, m, (size_t)n) != 0;
+        for (int i = 0; i < n; i++) {
+            vec_failed |= m[i].status != 0 || memcmp(tags[i], k ? cmac_tags256[i] : cmac_tags[i], 16);
+        }
+        vec_failed |= aes128_cmac_verify_batch(&c, m, (size_t)n) != 0;
+        printf("CMAC batch %s: %s\n", k ? "SP 800-38B D.3" : "RFC 4493", vec_failed ? "FAILED" : "OK");
+        failed |= vec_failed;
+    }
+
+    /* A 20-byte header shared by the odd-numbered messages */
+    aes128_cmac_init(&c, cmac_key, sizeof cmac_key);
+    aes128_cmac_stream_init(&s, &c);
+    aes128_cmac_stream_update(&s, cmac_msg, 20);
+    aes128_cmac_stream_save(&s, &hdr);
+
+    for (int i = 0; i < N; i++) {
+        fill_random(in[i], sizeof in[i]);
+        m[i].prefix = (i & 1) ? &hdr : NULL;
+        m[i].in = in[i];
+        m[i].len = (size_t)(i * i * 3 % 301);
+        m[i].tag = tags[i];
+        m[i].tag_len = (i % 3) ? 16 : 12;
+        m[i].status = 1;
+    }
+    m[4].len = 0;
+    m[5].len = 0;
+    m[8].tag_len = 0;
+
+    vec_failed = aes128_cmac_sign_batch(&c, m, N) != -1;
+    for (int i = 0; i < N; i++) {
+        if (i == 8) {
+            vec_failed |= m[i].status != -1;
+            continue;
+        }
+        aes128_cmac_stream_init(&s, &c);
+        if (i & 1) {
+            aes128_cmac_stream_update(&s, cmac_msg, 20);
+        }
+        aes128_cmac_stream_update(&s, in[i], m[i].len);
+        aes128_cmac_stream_final(&s, ref);
+        vec_failed |= m[i].status != 0 || memcmp(tags[i], ref, m[i].tag_len) != 0;
+    }
+    printf("CMAC batch against streaming, bad tag length: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    /* Verify them back, with one tampered tag failing alone */
+    m[8].tag_len = 16;
+    aes128_cmac_sign(&c, in[8], m[8].len, tags[8]);
+    tags[14][3] ^= 0x40;
+    vec_failed = aes128_cmac_verify_batch(&c, m, N) != -1;
+    for (int i = 0; i < N; i++) {
+        vec_failed |= m[i].status != (i == 14 ? -1 : 0);
+    }
+    tags[14][3] ^= 0x40;
+    vec_failed |= aes128_cmac_verify_batch(&c, m, N) != 0;
+    printf("CMAC batch verify, one tampered tag: %s\n", vec_failed ? "FAILED" : "OK");
+    failed |= vec_failed;
+
+    return failed;
+}
+
 /* ================================================================
  *  main                                                            
  * ================================================================*/
@@ -1174,16 +2404,29 @@ int main(void)
 {
     int rc = 0;
     rc |= ecb_test();
+    rc |= ecb_blocks_test();
+    rc |= shared_key_test();
+    rc |= aes256_test();
     rc |= cbc_test();      aes_monte_carlo_cbc();
     rc |= cfb_test();
     rc |= ofb_test();      aes_monte_carlo_ofb();
     rc |= ctr_test();
     rc |= xts_test();
     rc |= eax_test();
+    rc |= eax_stream_test();
     rc |= ccm_test();
+    rc |= ccm_batch_test();
     rc |= gcm_siv_test();
     rc |= gcm_test();
+    rc |= gf_long_test();
+    rc |= gcm_stream_test();
+    rc |= gcm_batch_test();
+    rc |= gcm_prefix_test();
+    rc |= gmac_test();
+    rc |= gcm_nonce_test();
     rc |= lightmac_test();
     rc |= lightmac_tamper_fuzz_test();
+    rc |= cmac_test();
+    rc |= cmac_batch_test();
     return rc;
 }